@@ -0,0 +1,392 @@
+#include "batch.h"
+#include "headless.h"
+#include "renderer.h"
+#include "shader_preprocessor.h"
+#include <SDL3/SDL.h>
+#include <algorithm>
+#include <atomic>
+#include <sstream>
+#include <string.h>
+#include <thread>
+
+#include "stb_image.h"
+#include "stb_image_write.h"
+
+static const float kFrameRate = 60.0f;     // iTimeDelta/iFrame for a still at time t
+
+bool ParseBatchArgs(int argc, char* argv[], BatchOptions* opts){
+    bool batch = false;
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* next = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (SDL_strcmp(arg, "--batch") == 0 && next) {
+            batch = true;
+            opts->shaderDir = next; i++;
+        } else if (SDL_strcmp(arg, "--out") == 0 && next) {
+            opts->outputDir = next; i++;
+        } else if (SDL_strcmp(arg, "--compare") == 0 && next) {
+            opts->referenceDir = next; i++;
+        } else if (SDL_strcmp(arg, "--times") == 0 && next) {
+            opts->times.clear();
+            std::istringstream list(next);
+            std::string item;
+            while (std::getline(list, item, ',')) {
+                opts->times.push_back((float)SDL_atof(item.c_str()));
+            }
+            i++;
+        } else if (SDL_strcmp(arg, "--sizes") == 0 && next) {
+            opts->sizes.clear();
+            std::istringstream list(next);
+            std::string item;
+            while (std::getline(list, item, ',')) {
+                BatchSize size;
+                SDL_sscanf(item.c_str(), "%dx%d", &size.width, &size.height);
+                opts->sizes.push_back(size);
+            }
+            i++;
+        } else if (SDL_strcmp(arg, "--threads") == 0 && next) {
+            opts->threads = SDL_atoi(next); i++;
+        } else if (SDL_strcmp(arg, "--tolerance") == 0 && next) {
+            opts->tolerance = SDL_atoi(next); i++;
+        } else if (SDL_strcmp(arg, "--max-bad-pixels") == 0 && next) {
+            opts->maxBadPixels = (float)SDL_atof(next); i++;
+        }
+    }
+    return batch;
+}
+
+// Shared state ////
+// Shaders are expanded up front on the calling thread, the include cache is
+// not thread safe. Each entry is then only touched by the worker that took it.
+struct BatchShader {
+    std::string name;       // file name without .glsl
+    std::string path;
+    std::string source;
+    SourceMap sourceMap;
+    bool queued = false;
+    bool done = false;
+    int images = 0;
+    int failures = 0;
+};
+
+struct BatchRun {
+    const BatchOptions* opts = NULL;
+    const std::string* vertexSource = NULL;
+    std::vector<BatchShader> shaders;
+    std::atomic<size_t> next{0};    // head of the queue
+};
+
+static std::string ImageName(const std::string& shader, const BatchSize& size, float time, const char* suffix){
+    char name[96];
+    SDL_snprintf(name, sizeof(name), "_%dx%d_t%g%s.png", size.width, size.height, time, suffix);
+    return shader + name;
+}
+
+static std::string JoinPath(const std::string& dir, const std::string& name){
+    if (dir.empty() || dir.back() == '/' || dir.back() == '\\') {
+        return dir + name;
+    }
+    return dir + "/" + name;
+}
+
+// Images ////
+static bool WritePng(const std::string& path, int width, int height, const std::vector<unsigned char>& pixels){
+    if (!stbi_write_png(path.c_str(), width, height, 4, pixels.data(), width * 4)) {
+        SDL_Log("Failed to write '%s'", path.c_str());
+        return false;
+    }
+    return true;
+}
+
+static bool LoadReference(const std::string& path, int width, int height, std::vector<unsigned char>* pixels){
+    size_t size = 0;
+    void* bytes = SDL_LoadFile(path.c_str(), &size);
+    if (bytes == NULL) {
+        SDL_Log("FAIL '%s': no reference image", path.c_str());
+        return false;
+    }
+    int w = 0, h = 0, channels = 0;
+    unsigned char* decoded = stbi_load_from_memory((const unsigned char*)bytes, (int)size, &w, &h, &channels, 4);
+    SDL_free(bytes);
+    if (decoded == NULL) {
+        SDL_Log("FAIL '%s': %s", path.c_str(), stbi_failure_reason());
+        return false;
+    }
+    bool sized = w == width && h == height;
+    if (sized) {
+        pixels->assign(decoded, decoded + (size_t)w * h * 4);
+    } else {
+        SDL_Log("FAIL '%s': reference is %dx%d, render is %dx%d", path.c_str(), w, h, width, height);
+    }
+    stbi_image_free(decoded);
+    return sized;
+}
+
+// Counts the pixels where any channel is off by more than `tolerance`. The
+// diff image shows the per-channel difference, amplified, on opaque black.
+static size_t DiffImages(const std::vector<unsigned char>& a, const std::vector<unsigned char>& b, int tolerance,
+                         int* maxDelta, std::vector<unsigned char>* diffImage){
+    size_t badPixels = 0;
+    *maxDelta = 0;
+    diffImage->resize(a.size());
+    for (size_t p = 0; p < a.size(); p += 4) {
+        int pixelDelta = 0;
+        for (int c = 0; c < 4; c++) {
+            int delta = SDL_abs((int)a[p + c] - (int)b[p + c]);
+            pixelDelta = SDL_max(pixelDelta, delta);
+            if (c < 3) {
+                (*diffImage)[p + c] = (unsigned char)SDL_min(delta * 8, 255);
+            }
+        }
+        (*diffImage)[p + 3] = 255;
+        *maxDelta = SDL_max(*maxDelta, pixelDelta);
+        if (pixelDelta > tolerance) {
+            badPixels++;
+        }
+    }
+    return badPixels;
+}
+
+static bool CompareImage(const BatchOptions& opts, const std::string& name, const std::string& diffName,
+                         int width, int height, const std::vector<unsigned char>& pixels){
+    std::vector<unsigned char> reference;
+    std::string referencePath = JoinPath(opts.referenceDir, name);
+    bool ok = LoadReference(referencePath, width, height, &reference);
+    std::vector<unsigned char> diff;
+    if (ok) {
+        int maxDelta = 0;
+        size_t badPixels = DiffImages(pixels, reference, opts.tolerance, &maxDelta, &diff);
+        double badFraction = (double)badPixels / ((double)width * height);
+        ok = badFraction <= opts.maxBadPixels;
+        if (!ok) {
+            SDL_Log("FAIL '%s': %llu pixels (%.3f%%) off by more than %d, up to %d",
+                    referencePath.c_str(), (unsigned long long)badPixels, badFraction * 100.0, opts.tolerance, maxDelta);
+        }
+    }
+    if (!ok && !opts.outputDir.empty()) {
+        WritePng(JoinPath(opts.outputDir, name), width, height, pixels);
+        if (!diff.empty()) {
+            WritePng(JoinPath(opts.outputDir, diffName), width, height, diff);
+        }
+    }
+    return ok;
+}
+
+// Rendering (worker threads) ////
+struct BatchTarget {
+    GLuint fbo = 0;
+    GLuint color = 0;
+    int width = 0;
+    int height = 0;
+};
+
+static bool ResizeTarget(BatchTarget* target, int width, int height){
+    if (target->fbo != 0 && target->width == width && target->height == height) {
+        return true;
+    }
+    if (target->fbo == 0) {
+        glGenFramebuffers(1, &target->fbo);
+        glGenRenderbuffers(1, &target->color);
+    }
+    glBindRenderbuffer(GL_RENDERBUFFER, target->color);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glBindFramebuffer(GL_FRAMEBUFFER, target->fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, target->color);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        SDL_Log("Offscreen framebuffer %dx%d is incomplete", width, height);
+        target->width = 0;
+        target->height = 0;
+        return false;
+    }
+    glViewport(0, 0, width, height);
+    target->width = width;
+    target->height = height;
+    return true;
+}
+
+static void DestroyTarget(BatchTarget* target){
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &target->fbo);
+    glDeleteRenderbuffers(1, &target->color);
+    *target = BatchTarget();
+}
+
+// GL rows are bottom-up, PNGs and references top-down.
+static void ReadTarget(const BatchTarget& target, std::vector<unsigned char>* pixels){
+    size_t stride = (size_t)target.width * 4;
+    pixels->resize(stride * target.height);
+    glReadPixels(0, 0, target.width, target.height, GL_RGBA, GL_UNSIGNED_BYTE, pixels->data());
+    std::vector<unsigned char> row(stride);
+    for (int y = 0; y < target.height / 2; y++) {
+        unsigned char* top = pixels->data() + (size_t)y * stride;
+        unsigned char* bottom = pixels->data() + (size_t)(target.height - 1 - y) * stride;
+        memcpy(row.data(), top, stride);
+        memcpy(top, bottom, stride);
+        memcpy(bottom, row.data(), stride);
+    }
+}
+
+static void RenderShader(BatchRun* run, BatchShader* shader, const ShaderQuad& quad, BatchTarget* target){
+    const BatchOptions& opts = *run->opts;
+    std::string log;
+    GLuint program = CompileProgram(*run->vertexSource, shader->source, &log);
+    if (program == 0) {
+        SDL_Log("FAIL '%s':\n%s", shader->path.c_str(), MapShaderLog(log, shader->sourceMap).c_str());
+        shader->failures++;
+        return;
+    }
+    ProgramReflection reflection;
+    ReflectProgram(program, &reflection);
+
+    std::vector<unsigned char> pixels;
+    for (const BatchSize& size : opts.sizes) {
+        if (!ResizeTarget(target, size.width, size.height)) {
+            // every image of this size counts, so the run can't pass without them
+            shader->images += (int)opts.times.size();
+            shader->failures += (int)opts.times.size();
+            continue;
+        }
+        for (float time : opts.times) {
+            ShaderInputs in;
+            in.width = (float)size.width;
+            in.height = (float)size.height;
+            in.time = time;
+            in.timeDelta = 1.0f / kFrameRate;
+            in.frameRate = kFrameRate;
+            in.frame = (int)(time * kFrameRate);
+            in.date[3] = time;
+            glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+            glClear(GL_COLOR_BUFFER_BIT);
+            DrawShaderQuad(program, reflection, quad, in);
+            ReadTarget(*target, &pixels);
+
+            std::string name = ImageName(shader->name, size, time, "");
+            bool ok = opts.referenceDir.empty()
+                ? WritePng(JoinPath(opts.outputDir, name), size.width, size.height, pixels)
+                : CompareImage(opts, name, ImageName(shader->name, size, time, "_diff"), size.width, size.height, pixels);
+            shader->images++;
+            if (!ok) {
+                shader->failures++;
+            }
+        }
+    }
+    glDeleteProgram(program);
+}
+
+// Same state as the window: one quad, blending off so files keep the raw
+// shader output, alpha included.
+static void RunWorker(BatchRun* run, HeadlessContext* ctx){
+    if (!MakeHeadlessContextCurrent(ctx)) {
+        SDL_Log("Couldn't make a batch context current, worker stopped");
+        return;
+    }
+    ShaderQuad quad;
+    CreateFullscreenQuad(&quad);
+    BatchTarget target;
+    glDisable(GL_BLEND);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    for (;;) {
+        size_t index = run->next.fetch_add(1);
+        if (index >= run->shaders.size()) {
+            break;
+        }
+        BatchShader& shader = run->shaders[index];
+        if (shader.queued) {
+            RenderShader(run, &shader, quad, &target);
+        }
+        shader.done = true;
+    }
+    DestroyTarget(&target);
+    DestroyFullscreenQuad(&quad);
+    ReleaseHeadlessContext(ctx);
+}
+
+// Batch ////
+bool RunBatch(const BatchOptions& opts, const std::string& vertexSource){
+    bool sizesValid = !opts.sizes.empty();
+    for (const BatchSize& size : opts.sizes) {
+        sizesValid = sizesValid && size.width > 0 && size.height > 0;
+    }
+    if (opts.shaderDir.empty() || (opts.outputDir.empty() && opts.referenceDir.empty()) || !sizesValid || opts.times.empty()) {
+        SDL_Log("usage: main --batch <dir> (--out <dir> | --compare <reference dir> [--out <dir>]) [--times 0,1.5] [--sizes 512x288,1920x1080]"
+                " [--threads N] [--tolerance 0-255] [--max-bad-pixels fraction]");
+        return false;
+    }
+
+    int count = 0;
+    char** files = SDL_GlobDirectory(opts.shaderDir.c_str(), "*.glsl", 0, &count);
+    if (files == NULL) {
+        SDL_Log("Couldn't list '%s': %s", opts.shaderDir.c_str(), SDL_GetError());
+        return false;
+    }
+    std::vector<std::string> names(files, files + count);
+    SDL_free(files);
+    std::sort(names.begin(), names.end());
+    if (names.empty()) {
+        SDL_Log("No .glsl files in '%s'", opts.shaderDir.c_str());
+        return false;
+    }
+
+    BatchRun run;
+    run.opts = &opts;
+    run.vertexSource = &vertexSource;
+    run.shaders.resize(names.size());
+    for (size_t i = 0; i < names.size(); i++) {
+        BatchShader& shader = run.shaders[i];
+        shader.path = JoinPath(opts.shaderDir, names[i]);
+        shader.name = names[i].substr(0, names[i].size() - SDL_strlen(".glsl"));
+        std::string error;
+        shader.queued = ExpandShader(shader.path, &shader.source, &shader.sourceMap, &error);
+        if (!shader.queued) {
+            SDL_Log("FAIL %s", error.c_str());
+            shader.failures++;
+        }
+    }
+    if (!opts.outputDir.empty() && !SDL_CreateDirectory(opts.outputDir.c_str())) {
+        SDL_Log("Couldn't create '%s': %s", opts.outputDir.c_str(), SDL_GetError());
+        return false;
+    }
+
+    // contexts are created here and handed to the workers, so GL entry points
+    // are loaded before any worker calls them
+    int threadCount = opts.threads > 0 ? opts.threads : SDL_GetNumLogicalCPUCores();
+    threadCount = SDL_max(1, SDL_min(threadCount, (int)run.shaders.size()));
+    std::vector<HeadlessContext*> contexts;
+    for (int i = 0; i < threadCount; i++) {
+        HeadlessContext* ctx = CreateHeadlessContext();
+        if (!ctx) {
+            break;
+        }
+        ReleaseHeadlessContext(ctx);
+        contexts.push_back(ctx);
+    }
+    if (contexts.empty()) {
+        return false;
+    }
+
+    Uint64 start = SDL_GetPerformanceCounter();
+    std::vector<std::thread> workers;
+    for (HeadlessContext* ctx : contexts) {
+        workers.emplace_back(RunWorker, &run, ctx);
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    double seconds = (double)(SDL_GetPerformanceCounter() - start) / (double)SDL_GetPerformanceFrequency();
+    for (HeadlessContext* ctx : contexts) {
+        DestroyHeadlessContext(ctx);
+    }
+
+    int images = 0;
+    int failures = 0;
+    for (const BatchShader& shader : run.shaders) {
+        if (!shader.done) {
+            SDL_Log("FAIL '%s': not rendered", shader.path.c_str());
+        }
+        images += shader.images;
+        failures += shader.done ? shader.failures : 1;
+    }
+    SDL_Log("%s %d images of %d shaders in %.2fs on %d threads, %d failed",
+            opts.referenceDir.empty() ? "Rendered" : "Compared", images, (int)run.shaders.size(), seconds, (int)contexts.size(), failures);
+    return failures == 0;
+}
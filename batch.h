@@ -0,0 +1,34 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// Batch rendering ////
+// Renders every .glsl file of a directory at a set of times and sizes to PNG,
+// `<name>_<W>x<H>_t<time>.png`. Worker threads each own a surfaceless context
+// with the same program/quad setup as the window and pull shaders off a shared
+// queue, so a library of shaders renders in parallel.
+//
+// With a reference directory the renders are compared against the files of
+// the same name instead: an image fails when more than `maxBadPixels` of its
+// pixels differ by more than `tolerance` in any channel. Failing renders and
+// a diff image are written to the output directory when one is given.
+struct BatchSize {
+    int width = 0;
+    int height = 0;
+};
+
+struct BatchOptions {
+    std::string shaderDir;
+    std::string outputDir;
+    std::string referenceDir;       // compare mode when set
+    std::vector<float> times = { 0.0f };
+    std::vector<BatchSize> sizes = { { 512, 288 } };
+    int threads = 0;                // 0 = one per logical core
+    int tolerance = 2;              // 0-255 per channel
+    float maxBadPixels = 0.0f;      // fraction of the image
+};
+
+// Returns true when argv asks for a batch (`--batch <dir>`).
+bool ParseBatchArgs(int argc, char* argv[], BatchOptions* opts);
+// False when a shader failed to build or an image failed to compare or save.
+bool RunBatch(const BatchOptions& opts, const std::string& vertexSource);
@@ -0,0 +1,269 @@
+// Drives TextEditor through a headless ImGui context (no window, no renderer) and
+// prints timings of its hot paths as JSON.
+#include "TextEditor.h"
+#include "imgui.h"
+#include <SDL3/SDL.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct BenchResult {
+    std::string name;
+    int lines = 0;
+    std::vector<double> samples;   // milliseconds
+};
+
+struct TimingStats {
+    double min = 0.0;
+    double median = 0.0;
+    double p99 = 0.0;
+    double mean = 0.0;
+};
+
+static const int kRuns = 5;
+static const int kKeystrokes = 500;
+static const int kRenderFrames = 300;
+static const int kScrollLinesPerFrame = 3;
+
+static double NowMs(){
+    return (double)SDL_GetPerformanceCounter() * 1000.0 / (double)SDL_GetPerformanceFrequency();
+}
+
+// Null renderer ////
+// Textures the font atlas asks for are marked as uploaded, nothing is drawn.
+static void UpdateTextures(){
+    for (ImTextureData* tex : ImGui::GetPlatformIO().Textures) {
+        if (tex->Status == ImTextureStatus_WantCreate || tex->Status == ImTextureStatus_WantUpdates) {
+            tex->SetTexID((ImTextureID)1);
+            tex->SetStatus(ImTextureStatus_OK);
+        } else if (tex->Status == ImTextureStatus_WantDestroy && tex->UnusedFrames > 0) {
+            tex->SetTexID(ImTextureID_Invalid);
+            tex->SetStatus(ImTextureStatus_Destroyed);
+        }
+    }
+}
+
+// One ImGui frame with the editor filling the display, scrolled to firstLine when >= 0.
+static void Frame(TextEditor* editor, int firstLine){
+    ImGui::NewFrame();
+    ImGui::SetNextWindowPos(ImVec2(0.0f, 0.0f));
+    ImGui::SetNextWindowSize(ImGui::GetIO().DisplaySize);
+    ImGui::Begin("bench", NULL, ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_NoSavedSettings);
+    if (firstLine >= 0) {
+        ImGui::SetNextWindowScroll(ImVec2(0.0f, (float)firstLine * ImGui::GetTextLineHeightWithSpacing()));
+    }
+    editor->Render("editor");
+    ImGui::End();
+    ImGui::Render();
+    UpdateTextures();
+}
+
+static void FinishColorize(TextEditor* editor, int firstLine){
+    do {
+        Frame(editor, firstLine);
+    } while (editor->IsColorizing());
+}
+
+// Corpus ////
+// Every token class the GLSL colorizer knows, block comments across lines and tabs included.
+static std::string MakeCorpus(int lines){
+    static const char* kBlock[] = {
+        "// value noise helpers %d",
+        "#define OCTAVES 5",
+        "#ifdef USE_TEXTURE",
+        "uniform sampler2D iChannel0;",
+        "#endif",
+        "/* hashed integer lattice,",
+        "   smoothed with a cubic */",
+        "float hash%d(vec2 p) {",
+        "    p = fract(p * vec2(123.34, 456.21));",
+        "    p += dot(p, p + 45.32);",
+        "    return fract(p.x * p.y);",
+        "}",
+        "vec3 shade%d(in vec3 n, in vec3 l, float k) {",
+        "\tfloat d = max(dot(n, l), 0.0); // lambert",
+        "\treturn vec3(0.8, 0.6, 0.4) * d + k * 1e-3 + float(0x1Fu);",
+        "}",
+        "",
+    };
+    const int blockLines = (int)SDL_arraysize(kBlock);
+    std::string text;
+    char line[128];
+    for (int i = 0; i < lines; i++) {
+        SDL_snprintf(line, sizeof(line), kBlock[i % blockLines], i / blockLines);
+        text += line;
+        if (i + 1 < lines) {
+            text += '\n';
+        }
+    }
+    return text;
+}
+
+// Benchmarks ////
+static void RunCorpus(int lines, std::vector<BenchResult>* results){
+    std::string corpus = MakeCorpus(lines);
+    TextEditor editor;
+    editor.SetLanguageDefinition(TextEditor::LanguageDefinition::GLSL());
+    const int middle = lines / 2;
+
+    BenchResult setText = { "set_text", lines };
+    BenchResult colorize = { "colorize", lines };
+    BenchResult getText = { "get_text", lines };
+    for (int run = 0; run < kRuns; run++) {
+        double start = NowMs();
+        editor.SetText(corpus);
+        setText.samples.push_back(NowMs() - start);
+
+        start = NowMs();
+        FinishColorize(&editor, middle);
+        colorize.samples.push_back(NowMs() - start);
+
+        start = NowMs();
+        std::string text = editor.GetText();
+        getText.samples.push_back(NowMs() - start);
+    }
+
+    // One edit and one frame per keystroke, as typing would do it
+    BenchResult insert = { "insert_text", lines };
+    BenchResult backspace = { "backspace", lines };
+    editor.SetCursorPosition(TextEditor::Coordinates(middle, 4));
+    for (int i = 0; i < kKeystrokes; i++) {
+        double start = NowMs();
+        editor.InsertText(i % 40 == 39 ? "\n" : (i % 7 == 0 ? " " : "x"));
+        Frame(&editor, middle);
+        insert.samples.push_back(NowMs() - start);
+    }
+    for (int i = 0; i < kKeystrokes; i++) {
+        double start = NowMs();
+        editor.Backspace();
+        Frame(&editor, middle);
+        backspace.samples.push_back(NowMs() - start);
+    }
+
+    // InsertText keeps no undo records, every backspace left one
+    BenchResult undo = { "undo_chain", lines };
+    BenchResult redo = { "redo_chain", lines };
+    for (int run = 0; run < kRuns; run++) {
+        double start = NowMs();
+        editor.Undo(kKeystrokes);
+        FinishColorize(&editor, middle);
+        undo.samples.push_back(NowMs() - start);
+
+        start = NowMs();
+        editor.Redo(kKeystrokes);
+        FinishColorize(&editor, middle);
+        redo.samples.push_back(NowMs() - start);
+    }
+
+    BenchResult render = { "render_scroll", lines };
+    int firstLine = 0;
+    for (int i = 0; i < kRenderFrames; i++) {
+        double start = NowMs();
+        Frame(&editor, firstLine);
+        render.samples.push_back(NowMs() - start);
+        firstLine = (firstLine + kScrollLinesPerFrame) % lines;
+    }
+
+    results->push_back(setText);
+    results->push_back(colorize);
+    results->push_back(getText);
+    results->push_back(insert);
+    results->push_back(backspace);
+    results->push_back(undo);
+    results->push_back(redo);
+    results->push_back(render);
+}
+
+// Report ////
+static TimingStats ComputeStats(std::vector<double> samples){
+    TimingStats stats;
+    if (samples.empty()) {
+        return stats;
+    }
+    std::sort(samples.begin(), samples.end());
+    size_t n = samples.size();
+    double sum = 0.0;
+    for (double s : samples) {
+        sum += s;
+    }
+    size_t p99Index = (size_t)std::ceil(0.99 * (double)n);
+    stats.min = samples[0];
+    stats.median = (n % 2) ? samples[n / 2] : 0.5 * (samples[n / 2 - 1] + samples[n / 2]);
+    stats.p99 = samples[std::min(n - 1, p99Index > 0 ? p99Index - 1 : 0)];
+    stats.mean = sum / (double)n;
+    return stats;
+}
+
+static std::string FormatReport(const std::vector<BenchResult>& results){
+    std::ostringstream json;
+    json << "{\n";
+    json << "  \"imgui\": \"" << IMGUI_VERSION << "\",\n";
+    json << "  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult& result = results[i];
+        TimingStats stats = ComputeStats(result.samples);
+        json << "    {\"name\": \"" << result.name << "\", \"lines\": " << result.lines
+             << ", \"samples\": " << result.samples.size()
+             << ", \"ms\": {\"min\": " << stats.min
+             << ", \"median\": " << stats.median
+             << ", \"p99\": " << stats.p99
+             << ", \"mean\": " << stats.mean << "}}"
+             << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    json << "  ]\n";
+    json << "}\n";
+    return json.str();
+}
+
+int main(int argc, char* argv[]){
+    std::vector<int> corpusLines = { 1000, 10000, 100000 };
+    std::string jsonPath;
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* next = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (SDL_strcmp(arg, "--lines") == 0 && next) {
+            corpusLines.clear();
+            std::istringstream list(next);
+            std::string item;
+            while (std::getline(list, item, ',')) {
+                if (SDL_atoi(item.c_str()) > 0) {
+                    corpusLines.push_back(SDL_atoi(item.c_str()));
+                }
+            }
+            i++;
+        } else if (SDL_strcmp(arg, "--json") == 0 && next) {
+            jsonPath = next; i++;
+        } else {
+            SDL_Log("usage: bench_texteditor [--lines 1000,10000,100000] [--json path]");
+            return 1;
+        }
+    }
+
+    ImGui::CreateContext();
+    ImGuiIO& io = ImGui::GetIO();
+    io.IniFilename = NULL;
+    io.LogFilename = NULL;
+    io.DisplaySize = ImVec2(1280.0f, 720.0f);
+    io.DeltaTime = 1.0f / 60.0f;
+    io.BackendFlags |= ImGuiBackendFlags_RendererHasTextures;
+    io.Fonts->AddFontDefault();
+
+    std::vector<BenchResult> results;
+    for (int lines : corpusLines) {
+        RunCorpus(lines, &results);
+    }
+    ImGui::DestroyContext();
+
+    std::string report = FormatReport(results);
+    if (jsonPath.empty()) {
+        fputs(report.c_str(), stdout);
+        fflush(stdout);
+    } else if (!SDL_SaveFile(jsonPath.c_str(), report.data(), report.size())) {
+        SDL_Log("Failed to save file: %s", SDL_GetError());
+        return 1;
+    }
+    return 0;
+}
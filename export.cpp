@@ -0,0 +1,474 @@
+#include "export.h"
+#include "headless.h"
+#include "renderer.h"
+#include "multipass.h"
+#include "shader_compiler.h"
+#include "shader_preprocessor.h"
+#include "texture_loader.h"
+#include "thread_pool.h"
+#include <SDL3/SDL.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+
+bool ParseExportArgs(int argc, char* argv[], ExportOptions* opts){
+    bool exporting = false;
+    float seconds = 0.0f;
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* next = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (SDL_strcmp(arg, "--export") == 0 && next) {
+            exporting = true;
+            opts->shaderPath = next; i++;
+        } else if (SDL_strcmp(arg, "--out") == 0 && next) {
+            opts->outputPath = next; i++;
+        } else if (SDL_strcmp(arg, "--size") == 0 && next) {
+            SDL_sscanf(next, "%dx%d", &opts->width, &opts->height); i++;
+        } else if (SDL_strcmp(arg, "--fps") == 0 && next) {
+            opts->fps = SDL_atoi(next); i++;
+        } else if (SDL_strcmp(arg, "--frames") == 0 && next) {
+            opts->frames = SDL_atoi(next); i++;
+        } else if (SDL_strcmp(arg, "--seconds") == 0 && next) {
+            seconds = (float)SDL_atof(next); i++;
+        } else if (SDL_strcmp(arg, "--start") == 0 && next) {
+            opts->startTime = (float)SDL_atof(next); i++;
+        }
+    }
+    if (seconds > 0.0f) {
+        opts->frames = (int)SDL_ceil(seconds * opts->fps);
+    }
+    return exporting;
+}
+
+// Encoding (worker threads) ////
+enum ExportFormat {
+    Export_PNG,
+    Export_Y4M
+};
+
+struct Encoder {
+    ExportFormat format = Export_PNG;
+    std::string pattern;        // png file names, one %d for the frame
+    FILE* video = NULL;
+    int width = 0;
+    int height = 0;
+    std::atomic<bool> failed{false};
+
+    ThreadPool pool;
+    std::mutex mutex;
+    std::condition_variable idle;
+    int inFlight = 0;
+    int maxInFlight = 0;
+    std::vector<std::vector<unsigned char>> freeBuffers;        // frame buffers are recycled, 4K is 33MB each
+    std::map<int, std::vector<unsigned char>> pendingVideo;     // converted frames waiting for their turn
+    int nextVideoFrame = 0;
+};
+
+static bool EndsWith(const std::string& s, const char* suffix){
+    size_t n = SDL_strlen(suffix);
+    return s.size() >= n && SDL_strcasecmp(s.c_str() + s.size() - n, suffix) == 0;
+}
+
+// Accepts exactly one integer conversion, the pattern ends up in snprintf.
+static bool IsFramePattern(const std::string& pattern){
+    int conversions = 0;
+    for (size_t i = 0; i < pattern.size(); i++) {
+        if (pattern[i] != '%') {
+            continue;
+        }
+        size_t j = i + 1;
+        if (j < pattern.size() && pattern[j] == '%') {
+            i = j;
+            continue;
+        }
+        while (j < pattern.size() && pattern[j] >= '0' && pattern[j] <= '9') {
+            j++;
+        }
+        if (j >= pattern.size() || pattern[j] != 'd') {
+            return false;
+        }
+        conversions++;
+        i = j;
+    }
+    return conversions == 1;
+}
+
+static std::vector<unsigned char> TakeBuffer(Encoder* enc, size_t size){
+    std::vector<unsigned char> buffer;
+    {
+        std::lock_guard<std::mutex> lock(enc->mutex);
+        if (!enc->freeBuffers.empty()) {
+            buffer.swap(enc->freeBuffers.back());
+            enc->freeBuffers.pop_back();
+        }
+    }
+    buffer.resize(size);
+    return buffer;
+}
+
+// GL rows are bottom-up, stb writes them flipped through a negative stride.
+static void EncodePng(Encoder* enc, int frame, const std::vector<unsigned char>& pixels){
+    char name[1024];
+    SDL_snprintf(name, sizeof(name), enc->pattern.c_str(), frame);
+    int stride = enc->width * 4;
+    const unsigned char* top = pixels.data() + (size_t)(enc->height - 1) * stride;
+    if (!stbi_write_png(name, enc->width, enc->height, 4, top, -stride)) {
+        SDL_Log("Failed to write '%s'", name);
+        enc->failed = true;
+    }
+}
+
+// RGBA to 4:2:0 full range BT.601 (C420jpeg), alpha is dropped.
+static void ConvertToI420(const unsigned char* rgba, int width, int height, std::vector<unsigned char>* out){
+    int chromaWidth = (width + 1) / 2;
+    int chromaHeight = (height + 1) / 2;
+    out->resize((size_t)width * height + 2 * (size_t)chromaWidth * chromaHeight);
+    unsigned char* yPlane = out->data();
+    unsigned char* uPlane = yPlane + (size_t)width * height;
+    unsigned char* vPlane = uPlane + (size_t)chromaWidth * chromaHeight;
+    for (int y = 0; y < height; y++) {
+        const unsigned char* row = rgba + (size_t)(height - 1 - y) * width * 4;
+        for (int x = 0; x < width; x++) {
+            const unsigned char* p = row + x * 4;
+            yPlane[(size_t)y * width + x] = (unsigned char)(0.299f * p[0] + 0.587f * p[1] + 0.114f * p[2] + 0.5f);
+        }
+    }
+    for (int cy = 0; cy < chromaHeight; cy++) {
+        for (int cx = 0; cx < chromaWidth; cx++) {
+            float r = 0.0f, g = 0.0f, b = 0.0f;
+            int count = 0;
+            for (int dy = 0; dy < 2; dy++) {
+                int y = SDL_min(cy * 2 + dy, height - 1);
+                const unsigned char* row = rgba + (size_t)(height - 1 - y) * width * 4;
+                for (int dx = 0; dx < 2; dx++) {
+                    const unsigned char* p = row + SDL_min(cx * 2 + dx, width - 1) * 4;
+                    r += p[0];
+                    g += p[1];
+                    b += p[2];
+                    count++;
+                }
+            }
+            r /= count;
+            g /= count;
+            b /= count;
+            uPlane[(size_t)cy * chromaWidth + cx] = (unsigned char)SDL_clamp(128.0f - 0.168736f * r - 0.331264f * g + 0.5f * b + 0.5f, 0.0f, 255.0f);
+            vPlane[(size_t)cy * chromaWidth + cx] = (unsigned char)SDL_clamp(128.0f + 0.5f * r - 0.418688f * g - 0.081312f * b + 0.5f, 0.0f, 255.0f);
+        }
+    }
+}
+
+// Frames convert in parallel and are appended to the stream in order.
+static void EncodeY4m(Encoder* enc, int frame, const std::vector<unsigned char>& pixels){
+    std::vector<unsigned char> planes;
+    ConvertToI420(pixels.data(), enc->width, enc->height, &planes);
+    std::lock_guard<std::mutex> lock(enc->mutex);
+    enc->pendingVideo[frame].swap(planes);
+    for (auto it = enc->pendingVideo.begin(); it != enc->pendingVideo.end() && it->first == enc->nextVideoFrame;) {
+        if (fputs("FRAME\n", enc->video) < 0 || fwrite(it->second.data(), 1, it->second.size(), enc->video) != it->second.size()) {
+            enc->failed = true;
+        }
+        it = enc->pendingVideo.erase(it);
+        enc->nextVideoFrame++;
+    }
+}
+
+// Blocks only while maxInFlight frames are still being encoded.
+static void SubmitFrame(Encoder* enc, int frame, std::vector<unsigned char>&& pixels){
+    {
+        std::unique_lock<std::mutex> lock(enc->mutex);
+        enc->idle.wait(lock, [enc]() { return enc->inFlight < enc->maxInFlight; });
+        enc->inFlight++;
+    }
+    std::shared_ptr<std::vector<unsigned char>> buffer = std::make_shared<std::vector<unsigned char>>(std::move(pixels));
+    SubmitJob(&enc->pool, [enc, frame, buffer]() {
+        if (enc->format == Export_PNG) {
+            EncodePng(enc, frame, *buffer);
+        } else {
+            EncodeY4m(enc, frame, *buffer);
+        }
+        std::lock_guard<std::mutex> lock(enc->mutex);
+        enc->freeBuffers.push_back(std::move(*buffer));
+        enc->inFlight--;
+        enc->idle.notify_all();
+    });
+}
+
+static void WaitForEncoder(Encoder* enc){
+    std::unique_lock<std::mutex> lock(enc->mutex);
+    enc->idle.wait(lock, [enc]() { return enc->inFlight == 0; });
+}
+
+static bool OpenEncoder(Encoder* enc, const ExportOptions& opts){
+    enc->width = opts.width;
+    enc->height = opts.height;
+    if (EndsWith(opts.outputPath, ".y4m")) {
+        enc->format = Export_Y4M;
+        enc->video = fopen(opts.outputPath.c_str(), "wb");
+        if (enc->video == NULL) {
+            SDL_Log("Couldn't open '%s' for writing", opts.outputPath.c_str());
+            return false;
+        }
+        fprintf(enc->video, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", opts.width, opts.height, opts.fps);
+    } else if (opts.outputPath.find('%') != std::string::npos) {
+        if (!IsFramePattern(opts.outputPath)) {
+            SDL_Log("'%s' needs exactly one frame number like %%05d", opts.outputPath.c_str());
+            return false;
+        }
+        enc->pattern = opts.outputPath;
+    } else {
+        if (!SDL_CreateDirectory(opts.outputPath.c_str())) {
+            SDL_Log("Couldn't create '%s': %s", opts.outputPath.c_str(), SDL_GetError());
+            return false;
+        }
+        enc->pattern = opts.outputPath + "/frame_%05d.png";
+    }
+    int workers = DefaultWorkerCount();
+    enc->maxInFlight = workers * 2;
+    StartThreadPool(&enc->pool, workers);
+    return true;
+}
+
+static bool CloseEncoder(Encoder* enc){
+    WaitForEncoder(enc);
+    StopThreadPool(&enc->pool);
+    if (enc->video != NULL && fclose(enc->video) != 0) {
+        enc->failed = true;
+    }
+    enc->video = NULL;
+    return !enc->failed;
+}
+
+// Readback (render thread) ////
+// Every frame is read into a pixel pack buffer behind a fence. Fences are
+// polled without waiting and finished frames go to the encoder in order;
+// while the GPU is behind, new frames get new buffers instead. Only with
+// READBACK_MAX frames in flight does the loop wait for the oldest one: that
+// is deliberate backpressure, so a GPU-bound export holds a bounded amount
+// of pixel memory rather than queueing every frame.
+struct ReadbackSlot {
+    GLuint pbo = 0;
+    GLsync fence = NULL;
+    int frame = -1;
+};
+
+struct ReadbackRing {
+    std::deque<ReadbackSlot> inFlight;  // oldest first
+    std::vector<GLuint> freePbos;
+    int pboCount = 0;
+    size_t frameBytes = 0;
+};
+
+static const int READBACK_MAX = 16;
+
+// Hands the frame of `slot` to the encoder once its fence signalled, waiting
+// at most `timeout` ns. False while the GPU is still on it.
+static bool CollectSlot(ReadbackSlot* slot, Encoder* enc, size_t frameBytes, GLuint64 timeout){
+    GLenum status = glClientWaitSync(slot->fence, 0, timeout);
+    if (status == GL_TIMEOUT_EXPIRED) {
+        return false;
+    }
+    glDeleteSync(slot->fence);
+    slot->fence = NULL;
+
+    std::vector<unsigned char> pixels = TakeBuffer(enc, frameBytes);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->pbo);
+    void* mapped = status == GL_WAIT_FAILED ? NULL : glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, frameBytes, GL_MAP_READ_BIT);
+    if (mapped != NULL) {
+        memcpy(pixels.data(), mapped, frameBytes);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    } else {
+        SDL_Log("Couldn't map readback of frame %d", slot->frame);
+        enc->failed = true;
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    SubmitFrame(enc, slot->frame, std::move(pixels));
+    slot->frame = -1;
+    return true;
+}
+
+static void RetireOldest(ReadbackRing* ring){
+    ring->freePbos.push_back(ring->inFlight.front().pbo);
+    ring->inFlight.pop_front();
+}
+
+// Collects every frame the GPU has finished, without waiting.
+static void CollectFinished(ReadbackRing* ring, Encoder* enc){
+    while (!ring->inFlight.empty() && CollectSlot(&ring->inFlight.front(), enc, ring->frameBytes, 0)) {
+        RetireOldest(ring);
+    }
+}
+
+// A free buffer, a new one below READBACK_MAX, or else the oldest in flight.
+static GLuint AcquirePbo(ReadbackRing* ring, Encoder* enc){
+    if (ring->freePbos.empty() && ring->pboCount < READBACK_MAX) {
+        GLuint pbo = 0;
+        glGenBuffers(1, &pbo);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+        glBufferData(GL_PIXEL_PACK_BUFFER, ring->frameBytes, NULL, GL_STREAM_READ);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        ring->pboCount++;
+        return pbo;
+    }
+    if (ring->freePbos.empty()) {
+        CollectSlot(&ring->inFlight.front(), enc, ring->frameBytes, GL_TIMEOUT_IGNORED); // the backpressure wait
+        RetireOldest(ring);
+    }
+    GLuint pbo = ring->freePbos.back();
+    ring->freePbos.pop_back();
+    return pbo;
+}
+
+// Export ////
+static void PrintShaderLogs(){
+    for (const std::string& log : TakeShaderLogs()) {
+        SDL_Log("%s", log.c_str());
+    }
+}
+
+bool RunExport(const ExportOptions& opts, const std::string& vertexSource){
+    if (opts.shaderPath.empty() || opts.outputPath.empty() || opts.width <= 0 || opts.height <= 0 || opts.frames <= 0 || opts.fps <= 0) {
+        SDL_Log("usage: main --export <shader.glsl|project.passes> --out <out.y4m|dir|frame_%%05d.png> [--size WxH] [--fps N] [--frames N | --seconds S] [--start seconds]");
+        return false;
+    }
+    bool project = EndsWith(opts.shaderPath, ".passes");
+    ProjectManifest manifest;
+    std::string fragmentSource;
+    SourceMap sourceMap;
+    std::string error;
+    if (project) {
+        if (!LoadProjectManifest(opts.shaderPath.c_str(), &manifest)) {
+            return false;
+        }
+        fragmentSource = manifest.passes[Pass_Image].source;
+        sourceMap = manifest.passes[Pass_Image].sourceMap;
+    } else if (!ExpandShader(opts.shaderPath, &fragmentSource, &sourceMap, &error)) {
+        SDL_Log("%s", error.c_str());
+        return false;
+    }
+
+    HeadlessContext* ctx = CreateHeadlessContext();
+    if (!ctx) {
+        return false;
+    }
+    std::string log;
+    GLuint program = CompileProgram(vertexSource, fragmentSource, &log);
+    if (program == 0) {
+        SDL_Log("%s", MapShaderLog(log, sourceMap).c_str());
+        DestroyHeadlessContext(ctx);
+        return false;
+    }
+    ProgramReflection reflection;
+    ReflectProgram(program, &reflection);
+    ShaderQuad quad;
+    CreateFullscreenQuad(&quad);
+
+    // without InitShaderCompiler buffer passes build synchronously on submit
+    InitTextureLoader();
+    Multipass multipass;
+    if (project) {
+        SetMultipassProject(&multipass, manifest, vertexSource);
+        PollMultipassCompile(&multipass);
+        PrintShaderLogs();
+    }
+    // every frame has to see its textures for the output to be deterministic
+    while (IsTextureLoadPending()) {
+        UpdateTextureLoader(64u * 1024 * 1024);
+        SDL_Delay(1);
+    }
+
+    GLuint fbo, colorBuffer;
+    glGenRenderbuffers(1, &colorBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, opts.width, opts.height);
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        SDL_Log("Offscreen framebuffer %dx%d is incomplete", opts.width, opts.height);
+        DestroyMultipass(&multipass);
+        ShutdownTextureLoader();
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteFramebuffers(1, &fbo);
+        glDeleteRenderbuffers(1, &colorBuffer);
+        DestroyFullscreenQuad(&quad);
+        glDeleteProgram(program);
+        DestroyHeadlessContext(ctx);
+        return false;
+    }
+    glViewport(0, 0, opts.width, opts.height);
+    glDisable(GL_BLEND); // files get the raw shader output, alpha included
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+    ReadbackRing ring;
+    ring.frameBytes = (size_t)opts.width * opts.height * 4;
+
+    Encoder enc;
+    bool ok = OpenEncoder(&enc, opts);
+    Uint64 start = SDL_GetPerformanceCounter();
+    const float timeStep = 1.0f / (float)opts.fps;
+    ShaderInputs in;
+    in.width = (float)opts.width;
+    in.height = (float)opts.height;
+    for (int i = 0; ok && i < opts.frames; i++) {
+        in.time = opts.startTime + (float)i * timeStep;
+        in.timeDelta = timeStep;
+        in.frameRate = (float)opts.fps;
+        in.frame = i;
+        in.date[3] = in.time;
+        if (project) {
+            RenderBufferPasses(&multipass, quad, in);
+            BindPassChannels(&multipass, Pass_Image, &in);
+        }
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+        DrawShaderQuad(program, reflection, quad, in);
+
+        CollectFinished(&ring, &enc);
+        ReadbackSlot slot;
+        slot.pbo = AcquirePbo(&ring, &enc);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+        glReadPixels(0, 0, opts.width, opts.height, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        slot.frame = i;
+        glFlush(); // polled fences have to reach the GPU to ever signal
+        ring.inFlight.push_back(slot);
+        ok = !enc.failed;
+    }
+    // oldest first so the video writer doesn't have to hold frames back
+    while (!ring.inFlight.empty()) {
+        if (ok) {
+            CollectSlot(&ring.inFlight.front(), &enc, ring.frameBytes, GL_TIMEOUT_IGNORED);
+        } else {
+            glDeleteSync(ring.inFlight.front().fence);
+        }
+        RetireOldest(&ring);
+    }
+    glDeleteBuffers((GLsizei)ring.freePbos.size(), ring.freePbos.data());
+    if (enc.maxInFlight > 0) {
+        ok = CloseEncoder(&enc) && ok;
+    }
+    double seconds = (double)(SDL_GetPerformanceCounter() - start) / (double)SDL_GetPerformanceFrequency();
+    if (ok) {
+        SDL_Log("Exported %d frames (%dx%d) to '%s' in %.2fs, %.1f fps",
+                opts.frames, opts.width, opts.height, opts.outputPath.c_str(), seconds, opts.frames / seconds);
+    }
+
+    DestroyMultipass(&multipass);
+    ShutdownTextureLoader();
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &fbo);
+    glDeleteRenderbuffers(1, &colorBuffer);
+    DestroyFullscreenQuad(&quad);
+    glDeleteProgram(program);
+    DestroyHeadlessContext(ctx);
+    return ok;
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include <string>
+
+// Deterministic export ////
+// Renders a shader or .passes project offscreen with a fixed time step, as
+// fast as the GPU allows, and writes a PNG sequence or a raw Y4M video.
+// Frames are read back through fenced pixel pack buffers and encoded on a
+// thread pool, so the render loop never waits on a transfer or the encoder
+// unless the GPU or the encoder is a whole bounded queue behind.
+struct ExportOptions {
+    std::string shaderPath;
+    std::string outputPath;     // out.y4m, a pattern like frames/%05d.png, or a directory
+    int width = 1920;
+    int height = 1080;
+    int fps = 60;
+    int frames = 600;
+    float startTime = 0.0f;
+};
+
+// Returns true when argv asks for an export (`--export <shader.glsl|project.passes>`).
+bool ParseExportArgs(int argc, char* argv[], ExportOptions* opts);
+bool RunExport(const ExportOptions& opts, const std::string& vertexSource);
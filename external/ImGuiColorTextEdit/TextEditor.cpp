@@ -4,6 +4,14 @@
 #include <regex>
 #include <cmath>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TEXTEDITOR_SSE2
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
 #include "TextEditor.h"
 
 #include "imgui.h"
@@ -41,6 +49,11 @@ TextEditor::TextEditor()
 	, mColorRangeMax(0)
 	, mSelectionMode(SelectionMode::Normal)
 	, mCheckComments(true)
+	, mCommentRangeMin(0)
+	, mCommentRangeMax(0)
+	, mLayoutGeneration(0)
+	, mAdvanceFont(nullptr)
+	, mAdvanceFontSize(0.0f)
 	, mLastClick(-1.0f)
 	, mHandleKeyboardInputs(true)
 	, mHandleMouseInputs(true)
@@ -51,6 +64,7 @@ TextEditor::TextEditor()
 	SetPalette(GetDarkPalette());
 	SetLanguageDefinition(LanguageDefinition::HLSL());
 	mLines.push_back(Line());
+	mLineStates.push_back(LineState());
 }
 
 TextEditor::~TextEditor()
@@ -65,6 +79,8 @@ void TextEditor::SetLanguageDefinition(const LanguageDefinition & aLanguageDef)
 	for (auto& r : mLanguageDefinition.mTokenRegexStrings)
 		mRegexList.push_back(std::make_pair(std::regex(r.first, std::regex_constants::optimize), r.second));
 
+	mWordTable.Build(mLanguageDefinition);
+
 	Colorize();
 }
 
@@ -88,23 +104,17 @@ std::string TextEditor::GetText(const Coordinates & aStart, const Coordinates &
 
 	result.reserve(s + s / 8);
 
-	while (istart < iend || lstart < lend)
+	for (int i = lstart; i <= lend && i < (int)mLines.size(); ++i)
 	{
-		if (lstart >= (int)mLines.size())
-			break;
-
-		auto& line = mLines[lstart];
-		if (istart < (int)line.size())
-		{
-			result += line[istart].mChar;
-			istart++;
-		}
-		else
+		auto& line = mLines[i];
+		auto from = i == lstart ? istart : 0;
+		if (i < lend)
 		{
-			istart = 0;
-			++lstart;
+			result.append(line.data() + from, line.size() - from);
 			result += '\n';
 		}
+		else if (from < iend)
+			result.append(line.data() + from, iend - from);
 	}
 
 	return result;
@@ -195,6 +205,114 @@ static inline int ImTextCharToUtf8(char* buf, int buf_size, unsigned int c)
 	}
 }
 
+static uint8_t RunValueAt(const TextEditor::Line::Runs& aRuns, int aIndex)
+{
+	auto it = std::upper_bound(aRuns.begin(), aRuns.end(), aIndex,
+		[](int aValue, const TextEditor::Line::Run& aRun) { return aValue < aRun.mStart; });
+	return it == aRuns.begin() ? 0 : (it - 1)->mValue;
+}
+
+// Appends a run unless it continues the last one, a last run left without glyphs is dropped
+static void PushRun(TextEditor::Line::Runs& aRuns, int aStart, uint8_t aValue)
+{
+	if (!aRuns.empty() && aRuns.back().mStart == aStart)
+		aRuns.pop_back();
+	if ((aRuns.empty() ? 0 : aRuns.back().mValue) != aValue)
+		aRuns.push_back({ aStart, aValue });
+}
+
+// Replaces glyphs [aBegin, aEnd) of a line of aSize glyphs with glyphs [aFromBegin, aFromEnd)
+// of aFrom, or with as many zero glyphs when aFrom is null
+static void SpliceRuns(TextEditor::Line::Runs& aRuns, int aSize, int aBegin, int aEnd,
+	const TextEditor::Line::Runs* aFrom, int aFromBegin, int aFromEnd)
+{
+	if (aRuns.empty() && (aFrom == nullptr || aFrom->empty()))
+		return;
+
+	TextEditor::Line::Runs result;
+	result.reserve(aRuns.size() + (aFrom != nullptr ? aFrom->size() : 0) + 2);
+
+	size_t i = 0;
+	for (; i < aRuns.size() && aRuns[i].mStart < aBegin; ++i)
+		result.push_back(aRuns[i]);
+
+	const int count = aFromEnd - aFromBegin;
+	if (count > 0)
+	{
+		PushRun(result, aBegin, aFrom != nullptr ? RunValueAt(*aFrom, aFromBegin) : 0);
+		if (aFrom != nullptr)
+		{
+			for (auto& run : *aFrom)
+				if (run.mStart > aFromBegin && run.mStart < aFromEnd)
+					PushRun(result, aBegin + run.mStart - aFromBegin, run.mValue);
+		}
+	}
+
+	if (aEnd < aSize)
+	{
+		const int shift = aBegin + count - aEnd;
+		PushRun(result, aEnd + shift, RunValueAt(aRuns, aEnd));
+		for (; i < aRuns.size(); ++i)
+			if (aRuns[i].mStart > aEnd)
+				PushRun(result, aRuns[i].mStart + shift, aRuns[i].mValue);
+	}
+
+	aRuns.swap(result);
+}
+
+// Stamps are never reused, 0 is left to lines that were never changed (and so are empty)
+static uint64_t NextLineStamp()
+{
+	static uint64_t stamp = 0;
+	return ++stamp;
+}
+
+void TextEditor::Line::Insert(int aIndex, const char* aChars, int aCount)
+{
+	SpliceRuns(mColors, (int)mChars.size(), aIndex, aIndex, nullptr, 0, aCount);
+	SpliceRuns(mFlags, (int)mChars.size(), aIndex, aIndex, nullptr, 0, aCount);
+	mChars.insert((size_t)aIndex, aChars, (size_t)aCount);
+	mStamp = NextLineStamp();
+}
+
+void TextEditor::Line::Insert(int aIndex, const Line& aFrom, int aBegin, int aEnd)
+{
+	SpliceRuns(mColors, (int)mChars.size(), aIndex, aIndex, &aFrom.mColors, aBegin, aEnd);
+	SpliceRuns(mFlags, (int)mChars.size(), aIndex, aIndex, &aFrom.mFlags, aBegin, aEnd);
+	mChars.insert((size_t)aIndex, aFrom.mChars, (size_t)aBegin, (size_t)(aEnd - aBegin));
+	mStamp = NextLineStamp();
+}
+
+void TextEditor::Line::Erase(int aBegin, int aEnd)
+{
+	SpliceRuns(mColors, (int)mChars.size(), aBegin, aEnd, nullptr, 0, 0);
+	SpliceRuns(mFlags, (int)mChars.size(), aBegin, aEnd, nullptr, 0, 0);
+	mChars.erase((size_t)aBegin, (size_t)(aEnd - aBegin));
+	mStamp = NextLineStamp();
+}
+
+void TextEditor::Line::SetColorRuns(const Runs& aRuns)
+{
+	mColors.assign(aRuns.begin(), aRuns.end());
+	mStamp = NextLineStamp();
+}
+
+void TextEditor::Line::SetFlagRuns(const Runs& aRuns)
+{
+	mFlags.assign(aRuns.begin(), aRuns.end());
+	mStamp = NextLineStamp();
+}
+
+TextEditor::PaletteIndex TextEditor::Line::GetColorIndex(int aIndex) const
+{
+	return (PaletteIndex)RunValueAt(mColors, aIndex);
+}
+
+uint8_t TextEditor::Line::GetFlags(int aIndex) const
+{
+	return RunValueAt(mFlags, aIndex);
+}
+
 void TextEditor::Advance(Coordinates & aCoordinates) const
 {
 	if (aCoordinates.mLine < (int)mLines.size())
@@ -204,7 +322,7 @@ void TextEditor::Advance(Coordinates & aCoordinates) const
 
 		if (cindex + 1 < (int)line.size())
 		{
-			auto delta = UTF8CharLength(line[cindex].mChar);
+			auto delta = UTF8CharLength(line[cindex]);
 			cindex = std::min(cindex + delta, (int)line.size() - 1);
 		}
 		else
@@ -234,20 +352,20 @@ void TextEditor::DeleteRange(const Coordinates & aStart, const Coordinates & aEn
 		auto& line = mLines[aStart.mLine];
 		auto n = GetLineMaxColumn(aStart.mLine);
 		if (aEnd.mColumn >= n)
-			line.erase(line.begin() + start, line.end());
+			line.Erase(start, (int)line.size());
 		else
-			line.erase(line.begin() + start, line.begin() + end);
+			line.Erase(start, end);
 	}
 	else
 	{
 		auto& firstLine = mLines[aStart.mLine];
 		auto& lastLine = mLines[aEnd.mLine];
 
-		firstLine.erase(firstLine.begin() + start, firstLine.end());
-		lastLine.erase(lastLine.begin(), lastLine.begin() + end);
+		firstLine.Erase(start, (int)firstLine.size());
+		lastLine.Erase(0, end);
 
 		if (aStart.mLine < aEnd.mLine)
-			firstLine.insert(firstLine.end(), lastLine.begin(), lastLine.end());
+			firstLine.Insert((int)firstLine.size(), lastLine, 0, (int)lastLine.size());
 
 		if (aStart.mLine < aEnd.mLine)
 			RemoveLine(aStart.mLine + 1, aEnd.mLine + 1);
@@ -277,8 +395,8 @@ int TextEditor::InsertTextAt(Coordinates& /* inout */ aWhere, const char * aValu
 			{
 				auto& newLine = InsertLine(aWhere.mLine + 1);
 				auto& line = mLines[aWhere.mLine];
-				newLine.insert(newLine.begin(), line.begin() + cindex, line.end());
-				line.erase(line.begin() + cindex, line.end());
+				newLine.Insert(0, line, cindex, (int)line.size());
+				line.Erase(cindex, (int)line.size());
 			}
 			else
 			{
@@ -292,11 +410,18 @@ int TextEditor::InsertTextAt(Coordinates& /* inout */ aWhere, const char * aValu
 		}
 		else
 		{
-			auto& line = mLines[aWhere.mLine];
-			auto d = UTF8CharLength(*aValue);
-			while (d-- > 0 && *aValue != '\0')
-				line.insert(line.begin() + cindex++, Glyph(*aValue++, PaletteIndex::Default));
-			++aWhere.mColumn;
+			// the whole run up to the next line break goes in at once
+			auto end = aValue;
+			while (*end != '\0' && *end != '\r' && *end != '\n')
+			{
+				auto d = UTF8CharLength(*end);
+				while (d-- > 0 && *end != '\0')
+					++end;
+				++aWhere.mColumn;
+			}
+			mLines[aWhere.mLine].Insert(cindex, aValue, (int)(end - aValue));
+			cindex += (int)(end - aValue);
+			aValue = end;
 		}
 
 		mTextChanged = true;
@@ -320,7 +445,7 @@ void TextEditor::AddUndo(UndoRecord& aValue)
 	++mUndoIndex;
 }
 
-TextEditor::Coordinates TextEditor::ScreenPosToCoordinates(const ImVec2& aPosition) const
+TextEditor::Coordinates TextEditor::ScreenPosToCoordinates(const ImVec2& aPosition)
 {
 	ImVec2 origin = ImGui::GetCursorScreenPos();
 	ImVec2 local(aPosition.x - origin.x, aPosition.y - origin.y);
@@ -331,42 +456,19 @@ TextEditor::Coordinates TextEditor::ScreenPosToCoordinates(const ImVec2& aPositi
 
 	if (lineNo >= 0 && lineNo < (int)mLines.size())
 	{
-		auto& line = mLines.at(lineNo);
-
-		int columnIndex = 0;
-		float columnX = 0.0f;
-
-		while ((size_t)columnIndex < line.size())
+		// The first glyph whose middle is right of the mouse, the line end if there is none
+		auto& glyphs = GetLineLayout(lineNo).mGlyphs;
+		int low = 0;
+		int high = (int)glyphs.size() - 1;
+		while (low < high)
 		{
-			float columnWidth = 0.0f;
-
-			if (line[columnIndex].mChar == '\t')
-			{
-				float spaceSize = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, " ").x;
-				float oldX = columnX;
-				float newColumnX = (1.0f + std::floor((1.0f + columnX) / (float(mTabSize) * spaceSize))) * (float(mTabSize) * spaceSize);
-				columnWidth = newColumnX - oldX;
-				if (mTextStart + columnX + columnWidth * 0.5f > local.x)
-					break;
-				columnX = newColumnX;
-				columnCoord = (columnCoord / mTabSize) * mTabSize + mTabSize;
-				columnIndex++;
-			}
+			auto mid = (low + high) / 2;
+			if (mTextStart + (glyphs[mid].mX + glyphs[mid + 1].mX) * 0.5f > local.x)
+				high = mid;
 			else
-			{
-				char buf[7];
-				auto d = UTF8CharLength(line[columnIndex].mChar);
-				int i = 0;
-				while (i < 6 && d-- > 0)
-					buf[i++] = line[columnIndex++].mChar;
-				buf[i] = '\0';
-				columnWidth = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, buf).x;
-				if (mTextStart + columnX + columnWidth * 0.5f > local.x)
-					break;
-				columnX += columnWidth;
-				columnCoord++;
-			}
+				low = mid + 1;
 		}
+		columnCoord = glyphs[low].mColumn;
 	}
 
 	return SanitizeCoordinates(Coordinates(lineNo, columnCoord));
@@ -384,13 +486,13 @@ TextEditor::Coordinates TextEditor::FindWordStart(const Coordinates & aFrom) con
 	if (cindex >= (int)line.size())
 		return at;
 
-	while (cindex > 0 && isspace(line[cindex].mChar))
+	while (cindex > 0 && isspace(line[cindex]))
 		--cindex;
 
-	auto cstart = (PaletteIndex)line[cindex].mColorIndex;
+	auto cstart = line.GetColorIndex(cindex);
 	while (cindex > 0)
 	{
-		auto c = line[cindex].mChar;
+		auto c = line[cindex];
 		if ((c & 0xC0) != 0x80)	// not UTF code sequence 10xxxxxx
 		{
 			if (c <= 32 && isspace(c))
@@ -398,7 +500,7 @@ TextEditor::Coordinates TextEditor::FindWordStart(const Coordinates & aFrom) con
 				cindex++;
 				break;
 			}
-			if (cstart != (PaletteIndex)line[size_t(cindex - 1)].mColorIndex)
+			if (cstart != line.GetColorIndex(cindex - 1))
 				break;
 		}
 		--cindex;
@@ -418,19 +520,19 @@ TextEditor::Coordinates TextEditor::FindWordEnd(const Coordinates & aFrom) const
 	if (cindex >= (int)line.size())
 		return at;
 
-	bool prevspace = isspace(line[cindex].mChar) != 0;
-	auto cstart = (PaletteIndex)line[cindex].mColorIndex;
+	bool prevspace = isspace(line[cindex]) != 0;
+	auto cstart = line.GetColorIndex(cindex);
 	while (cindex < (int)line.size())
 	{
-		auto c = line[cindex].mChar;
+		auto c = line[cindex];
 		auto d = UTF8CharLength(c);
-		if (cstart != (PaletteIndex)line[cindex].mColorIndex)
+		if (cstart != line.GetColorIndex(cindex))
 			break;
 
 		if (prevspace != !!isspace(c))
 		{
 			if (isspace(c))
-				while (cindex < (int)line.size() && isspace(line[cindex].mChar))
+				while (cindex < (int)line.size() && isspace(line[cindex]))
 					++cindex;
 			break;
 		}
@@ -452,7 +554,7 @@ TextEditor::Coordinates TextEditor::FindNextWord(const Coordinates & aFrom) cons
 	if (cindex < (int)mLines[at.mLine].size())
 	{
 		auto& line = mLines[at.mLine];
-		isword = isalnum(line[cindex].mChar) != 0;
+		isword = isalnum(line[cindex]) != 0;
 		skip = isword;
 	}
 
@@ -467,7 +569,7 @@ TextEditor::Coordinates TextEditor::FindNextWord(const Coordinates & aFrom) cons
 		auto& line = mLines[at.mLine];
 		if (cindex < (int)line.size())
 		{
-			isword = isalnum(line[cindex].mChar) != 0;
+			isword = isalnum(line[cindex]) != 0;
 
 			if (isword && !skip)
 				return Coordinates(at.mLine, GetCharacterColumn(at.mLine, cindex));
@@ -498,11 +600,11 @@ int TextEditor::GetCharacterIndex(const Coordinates& aCoordinates) const
 	int i = 0;
 	for (; i < line.size() && c < aCoordinates.mColumn;)
 	{
-		if (line[i].mChar == '\t')
+		if (line[i] == '\t')
 			c = (c / mTabSize) * mTabSize + mTabSize;
 		else
 			++c;
-		i += UTF8CharLength(line[i].mChar);
+		i += UTF8CharLength(line[i]);
 	}
 	return i;
 }
@@ -516,7 +618,7 @@ int TextEditor::GetCharacterColumn(int aLine, int aIndex) const
 	int i = 0;
 	while (i < aIndex && i < (int)line.size())
 	{
-		auto c = line[i].mChar;
+		auto c = line[i];
 		i += UTF8CharLength(c);
 		if (c == '\t')
 			col = (col / mTabSize) * mTabSize + mTabSize;
@@ -533,7 +635,7 @@ int TextEditor::GetLineCharacterCount(int aLine) const
 	auto& line = mLines[aLine];
 	int c = 0;
 	for (unsigned i = 0; i < line.size(); c++)
-		i += UTF8CharLength(line[i].mChar);
+		i += UTF8CharLength(line[i]);
 	return c;
 }
 
@@ -545,7 +647,7 @@ int TextEditor::GetLineMaxColumn(int aLine) const
 	int col = 0;
 	for (unsigned i = 0; i < line.size(); )
 	{
-		auto c = line[i].mChar;
+		auto c = line[i];
 		if (c == '\t')
 			col = (col / mTabSize) * mTabSize + mTabSize;
 		else
@@ -566,9 +668,29 @@ bool TextEditor::IsOnWordBoundary(const Coordinates & aAt) const
 		return true;
 
 	if (mColorizerEnabled)
-		return line[cindex].mColorIndex != line[size_t(cindex - 1)].mColorIndex;
+		return line.GetColorIndex(cindex) != line.GetColorIndex(cindex - 1);
+
+	return isspace(line[cindex]) != isspace(line[cindex - 1]);
+}
+
+// Pending colorize ranges are line numbers, keep them on the same lines while lines come and go
+static void RangeLinesRemoved(int& aMin, int& aMax, int aStart, int aEnd)
+{
+	if (aMin >= aMax)
+		return;
+	auto shift = [&](int aLine) { return aLine >= aEnd ? aLine - (aEnd - aStart) : std::min(aLine, aStart); };
+	aMin = shift(aMin);
+	aMax = shift(aMax);
+}
 
-	return isspace(line[cindex].mChar) != isspace(line[cindex - 1].mChar);
+static void RangeLineInserted(int& aMin, int& aMax, int aIndex)
+{
+	if (aMin >= aMax)
+		return;
+	if (aMin > aIndex)
+		++aMin;
+	if (aMax >= aIndex)
+		++aMax;
 }
 
 void TextEditor::RemoveLine(int aStart, int aEnd)
@@ -598,6 +720,10 @@ void TextEditor::RemoveLine(int aStart, int aEnd)
 
 	mLines.erase(mLines.begin() + aStart, mLines.begin() + aEnd);
 	assert(!mLines.empty());
+	if ((size_t)aEnd <= mLineStates.size())
+		mLineStates.erase(mLineStates.begin() + aStart, mLineStates.begin() + aEnd);
+	RangeLinesRemoved(mColorRangeMin, mColorRangeMax, aStart, aEnd);
+	RangeLinesRemoved(mCommentRangeMin, mCommentRangeMax, aStart, aEnd);
 
 	mTextChanged = true;
 }
@@ -628,6 +754,10 @@ void TextEditor::RemoveLine(int aIndex)
 
 	mLines.erase(mLines.begin() + aIndex);
 	assert(!mLines.empty());
+	if ((size_t)aIndex < mLineStates.size())
+		mLineStates.erase(mLineStates.begin() + aIndex);
+	RangeLinesRemoved(mColorRangeMin, mColorRangeMax, aIndex, aIndex + 1);
+	RangeLinesRemoved(mCommentRangeMin, mCommentRangeMax, aIndex, aIndex + 1);
 
 	mTextChanged = true;
 }
@@ -637,6 +767,10 @@ TextEditor::Line& TextEditor::InsertLine(int aIndex)
 	assert(!mReadOnly);
 
 	auto& result = *mLines.insert(mLines.begin() + aIndex, Line());
+	if ((size_t)aIndex <= mLineStates.size())
+		mLineStates.insert(mLineStates.begin() + aIndex, LineState());
+	RangeLineInserted(mColorRangeMin, mColorRangeMax, aIndex);
+	RangeLineInserted(mCommentRangeMin, mCommentRangeMax, aIndex);
 
 	ErrorMarkers etmp;
 	for (auto& i : mErrorMarkers)
@@ -668,21 +802,21 @@ std::string TextEditor::GetWordAt(const Coordinates & aCoords) const
 	auto iend = GetCharacterIndex(end);
 
 	for (auto it = istart; it < iend; ++it)
-		r.push_back(mLines[aCoords.mLine][it].mChar);
+		r.push_back(mLines[aCoords.mLine][it]);
 
 	return r;
 }
 
-ImU32 TextEditor::GetGlyphColor(const Glyph & aGlyph) const
+ImU32 TextEditor::GetGlyphColor(PaletteIndex aColorIndex, uint8_t aFlags) const
 {
 	if (!mColorizerEnabled)
 		return mPalette[(int)PaletteIndex::Default];
-	if (aGlyph.mComment)
+	if (aFlags & Line::CommentFlag)
 		return mPalette[(int)PaletteIndex::Comment];
-	if (aGlyph.mMultiLineComment)
+	if (aFlags & Line::MultiLineCommentFlag)
 		return mPalette[(int)PaletteIndex::MultiLineComment];
-	auto const color = mPalette[(int)aGlyph.mColorIndex];
-	if (aGlyph.mPreprocessor)
+	auto const color = mPalette[(int)aColorIndex];
+	if (aFlags & Line::PreprocessorFlag)
 	{
 		const auto ppcolor = mPalette[(int)PaletteIndex::Preprocessor];
 		const int c0 = ((ppcolor & 0xff) + (color & 0xff)) / 2;
@@ -853,7 +987,7 @@ void TextEditor::HandleMouseInputs()
 void TextEditor::Render()
 {
 	/* Compute mCharAdvance regarding to scaled font size (Ctrl + mouse wheel)*/
-	const float fontSize = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, "#", nullptr, nullptr).x;
+	const float fontSize = GetGlyphAdvance("#", 1);
 	mCharAdvance = ImVec2(fontSize, ImGui::GetTextLineHeightWithSpacing() * mLineSpacing);
 
 	/* Update palette with the current alpha from style */
@@ -864,8 +998,6 @@ void TextEditor::Render()
 		mPalette[i] = ImGui::ColorConvertFloat4ToU32(color);
 	}
 
-	assert(mLineBuffer.empty());
-
 	auto contentSize = ImGui::GetWindowContentRegionMax();
 	auto drawList = ImGui::GetWindowDrawList();
 	float longest(mTextStart);
@@ -887,11 +1019,20 @@ void TextEditor::Render()
 	// Deduce mTextStart by evaluating mLines size (global lineMax) plus two spaces as text width
 	char buf[16];
 	snprintf(buf, 16, " %d ", globalLineMax);
-	mTextStart = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, buf, nullptr, nullptr).x + mLeftMargin;
+	mTextStart = GetTextWidth(buf, buf + strlen(buf)) + mLeftMargin;
+
+	// Enough layout slots that the visible lines never share one
+	const int visibleLines = std::max(0, lineMax - lineNo + 1);
+	size_t layoutSlots = 64;
+	while (layoutSlots < (size_t)visibleLines * 2)
+		layoutSlots *= 2;
+	if (mLineLayouts.size() < layoutSlots)
+		mLineLayouts.assign(layoutSlots, LineLayout());
 
 	if (!mLines.empty())
 	{
-		float spaceSize = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, " ", nullptr, nullptr).x;
+		const auto clipMinX = drawList->GetClipRectMin().x;
+		const auto clipMaxX = drawList->GetClipRectMax().x;
 
 		while (lineNo <= lineMax)
 		{
@@ -899,10 +1040,11 @@ void TextEditor::Render()
 			ImVec2 textScreenPos = ImVec2(lineStartScreenPos.x + mTextStart, lineStartScreenPos.y);
 
 			auto& line = mLines[lineNo];
-			longest = std::max(mTextStart + TextDistanceToLineStart(Coordinates(lineNo, GetLineMaxColumn(lineNo))), longest);
-			auto columnNo = 0;
+			auto& layout = GetLineLayout(lineNo);
+			auto& glyphs = layout.mGlyphs;
+			longest = std::max(mTextStart + glyphs.back().mX, longest);
 			Coordinates lineStartCoord(lineNo, 0);
-			Coordinates lineEndCoord(lineNo, GetLineMaxColumn(lineNo));
+			Coordinates lineEndCoord(lineNo, glyphs.back().mColumn);
 
 			// Draw selection for the current line
 			float sstart = -1.0f;
@@ -955,10 +1097,7 @@ void TextEditor::Render()
 			}
 
 			// Draw line number (right aligned)
-			snprintf(buf, 16, "%d  ", lineNo + 1);
-
-			auto lineNoWidth = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, buf, nullptr, nullptr).x;
-			drawList->AddText(ImVec2(lineStartScreenPos.x + mTextStart - lineNoWidth, lineStartScreenPos.y), mPalette[(int)PaletteIndex::LineNumber], buf);
+			drawList->AddText(ImVec2(lineStartScreenPos.x + mTextStart - layout.mLineNumberWidth, lineStartScreenPos.y), mPalette[(int)PaletteIndex::LineNumber], layout.mLineNumberText);
 
 			if (mState.mCursorPosition.mLine == lineNo)
 			{
@@ -980,25 +1119,11 @@ void TextEditor::Render()
 					if (elapsed > 400)
 					{
 						float width = 1.0f;
-						auto cindex = GetCharacterIndex(mState.mCursorPosition);
-						float cx = TextDistanceToLineStart(mState.mCursorPosition);
+						auto glyph = FindLayoutGlyph(layout, mState.mCursorPosition.mColumn);
+						float cx = glyph->mX;
 
-						if (mOverwrite && cindex < (int)line.size())
-						{
-							auto c = line[cindex].mChar;
-							if (c == '\t')
-							{
-								auto x = (1.0f + std::floor((1.0f + cx) / (float(mTabSize) * spaceSize))) * (float(mTabSize) * spaceSize);
-								width = x - cx;
-							}
-							else
-							{
-								char buf2[2];
-								buf2[0] = line[cindex].mChar;
-								buf2[1] = '\0';
-								width = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, buf2).x;
-							}
-						}
+						if (mOverwrite && glyph->mIndex < (int)line.size())
+							width = glyph[1].mX - cx;
 						ImVec2 cstart(textScreenPos.x + cx, lineStartScreenPos.y);
 						ImVec2 cend(textScreenPos.x + cx + width, lineStartScreenPos.y + mCharAdvance.y);
 						drawList->AddRectFilled(cstart, cend, mPalette[(int)PaletteIndex::Cursor]);
@@ -1008,37 +1133,33 @@ void TextEditor::Render()
 				}
 			}
 
-			// Render colorized text
-			auto prevColor = line.empty() ? mPalette[(int)PaletteIndex::Default] : GetGlyphColor(line[0]);
-			ImVec2 bufferOffset;
-
-			for (int i = 0; i < line.size();)
+			// Render colorized text, one AddText per span that is at least partly visible
+			for (auto& span : layout.mSpans)
 			{
-				auto& glyph = line[i];
-				auto color = GetGlyphColor(glyph);
-
-				if ((color != prevColor || glyph.mChar == '\t' || glyph.mChar == ' ') && !mLineBuffer.empty())
-				{
-					const ImVec2 newOffset(textScreenPos.x + bufferOffset.x, textScreenPos.y + bufferOffset.y);
-					drawList->AddText(newOffset, prevColor, mLineBuffer.c_str());
-					auto textSize = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, mLineBuffer.c_str(), nullptr, nullptr);
-					bufferOffset.x += textSize.x;
-					mLineBuffer.clear();
-				}
-				prevColor = color;
+				if (textScreenPos.x + span.mX > clipMaxX)
+					break;
+				if (textScreenPos.x + span.mEndX < clipMinX)
+					continue;
+				drawList->AddText(ImVec2(textScreenPos.x + span.mX, textScreenPos.y), GetGlyphColor(span.mColorIndex, span.mFlags),
+					line.data() + span.mBegin, line.data() + span.mEnd);
+			}
 
-				if (glyph.mChar == '\t')
+			if (mShowWhitespaces)
+			{
+				const auto s = ImGui::GetFontSize();
+				const auto y = textScreenPos.y + s * 0.5f;
+				for (size_t i = 0; i + 1 < glyphs.size(); ++i)
 				{
-					auto oldX = bufferOffset.x;
-					bufferOffset.x = (1.0f + std::floor((1.0f + bufferOffset.x) / (float(mTabSize) * spaceSize))) * (float(mTabSize) * spaceSize);
-					++i;
+					const auto x = textScreenPos.x + glyphs[i].mX;
+					const auto nextX = textScreenPos.x + glyphs[i + 1].mX;
+					if (x > clipMaxX)
+						break;
 
-					if (mShowWhitespaces)
+					auto c = line[glyphs[i].mIndex];
+					if (c == '\t')
 					{
-						const auto s = ImGui::GetFontSize();
-						const auto x1 = textScreenPos.x + oldX + 1.0f;
-						const auto x2 = textScreenPos.x + bufferOffset.x - 1.0f;
-						const auto y = textScreenPos.y + bufferOffset.y + s * 0.5f;
+						const auto x1 = x + 1.0f;
+						const auto x2 = nextX - 1.0f;
 						const ImVec2 p1(x1, y);
 						const ImVec2 p2(x2, y);
 						const ImVec2 p3(x2 - s * 0.2f, y - s * 0.2f);
@@ -1047,33 +1168,9 @@ void TextEditor::Render()
 						drawList->AddLine(p2, p3, 0x90909090);
 						drawList->AddLine(p2, p4, 0x90909090);
 					}
+					else if (c == ' ')
+						drawList->AddCircleFilled(ImVec2((x + nextX) * 0.5f, y), 1.5f, 0x80808080, 4);
 				}
-				else if (glyph.mChar == ' ')
-				{
-					if (mShowWhitespaces)
-					{
-						const auto s = ImGui::GetFontSize();
-						const auto x = textScreenPos.x + bufferOffset.x + spaceSize * 0.5f;
-						const auto y = textScreenPos.y + bufferOffset.y + s * 0.5f;
-						drawList->AddCircleFilled(ImVec2(x, y), 1.5f, 0x80808080, 4);
-					}
-					bufferOffset.x += spaceSize;
-					i++;
-				}
-				else
-				{
-					auto l = UTF8CharLength(glyph.mChar);
-					while (l-- > 0)
-						mLineBuffer.push_back(line[i++].mChar);
-				}
-				++columnNo;
-			}
-
-			if (!mLineBuffer.empty())
-			{
-				const ImVec2 newOffset(textScreenPos.x + bufferOffset.x, textScreenPos.y + bufferOffset.y);
-				drawList->AddText(newOffset, prevColor, mLineBuffer.c_str());
-				mLineBuffer.clear();
 			}
 
 			++lineNo;
@@ -1128,6 +1225,8 @@ void TextEditor::Render(const char* aTitle, const ImVec2& aSize, bool aBorder)
 	if (!mIgnoreImGuiChild)
 		ImGui::BeginChild(aTitle, aSize, aBorder, ImGuiWindowFlags_HorizontalScrollbar | ImGuiWindowFlags_AlwaysHorizontalScrollbar | ImGuiWindowFlags_NoMove);
 
+	UpdateGlyphAdvances();
+
 	if (mHandleKeyboardInputs)
 	{
 		HandleKeyboardInputs();
@@ -1152,23 +1251,54 @@ void TextEditor::Render(const char* aTitle, const ImVec2& aSize, bool aBorder)
 	mWithinRender = false;
 }
 
+// First '\n' or '\r' in [aBegin, aEnd), checking 16 bytes at a time where SSE2 is available
+static const char* FindLineBreak(const char* aBegin, const char* aEnd)
+{
+#ifdef TEXTEDITOR_SSE2
+	const __m128i newLine = _mm_set1_epi8('\n');
+	const __m128i carriageReturn = _mm_set1_epi8('\r');
+	for (; aEnd - aBegin >= 16; aBegin += 16)
+	{
+		const __m128i chunk = _mm_loadu_si128((const __m128i*)aBegin);
+		const int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, newLine), _mm_cmpeq_epi8(chunk, carriageReturn)));
+		if (mask != 0)
+		{
+#ifdef _MSC_VER
+			unsigned long first;
+			_BitScanForward(&first, (unsigned long)mask);
+			return aBegin + first;
+#else
+			return aBegin + __builtin_ctz((unsigned)mask);
+#endif
+		}
+	}
+#endif
+	for (; aBegin != aEnd; ++aBegin)
+		if (*aBegin == '\n' || *aBegin == '\r')
+			return aBegin;
+	return aEnd;
+}
+
 void TextEditor::SetText(const std::string & aText)
 {
 	mLines.clear();
 	mLines.emplace_back(Line());
-	for (auto chr : aText)
+
+	// each line is copied in one piece, carriage returns are dropped
+	const char* p = aText.data();
+	const char* end = p + aText.size();
+	while (p != end)
 	{
-		if (chr == '\r')
-		{
-			// ignore the carriage return character
-		}
-		else if (chr == '\n')
+		auto lineBreak = FindLineBreak(p, end);
+		auto& line = mLines.back();
+		line.Insert((int)line.size(), p, (int)(lineBreak - p));
+		if (lineBreak == end)
+			break;
+		if (*lineBreak == '\n')
 			mLines.emplace_back(Line());
-		else
-		{
-			mLines.back().emplace_back(Glyph(chr, PaletteIndex::Default));
-		}
+		p = lineBreak + 1;
 	}
+	mLineStates.assign(mLines.size(), LineState());
 
 	mTextChanged = true;
 	mScrollToTop = true;
@@ -1192,14 +1322,9 @@ void TextEditor::SetTextLines(const std::vector<std::string> & aLines)
 		mLines.resize(aLines.size());
 
 		for (size_t i = 0; i < aLines.size(); ++i)
-		{
-			const std::string & aLine = aLines[i];
-
-			mLines[i].reserve(aLine.size());
-			for (size_t j = 0; j < aLine.size(); ++j)
-				mLines[i].emplace_back(Glyph(aLine[j], PaletteIndex::Default));
-		}
+			mLines[i].Insert(0, aLines[i].data(), (int)aLines[i].size());
 	}
+	mLineStates.assign(mLines.size(), LineState());
 
 	mTextChanged = true;
 	mScrollToTop = true;
@@ -1253,16 +1378,16 @@ void TextEditor::EnterCharacter(ImWchar aChar, bool aShift)
 				{
 					if (!line.empty())
 					{
-						if (line.front().mChar == '\t')
+						if (line[0] == '\t')
 						{
-							line.erase(line.begin());
+							line.Erase(0, 1);
 							modified = true;
 						}
 						else
 						{
-							for (int j = 0; j < mTabSize && !line.empty() && line.front().mChar == ' '; j++)
+							for (int j = 0; j < mTabSize && !line.empty() && line[0] == ' '; j++)
 							{
-								line.erase(line.begin());
+								line.Erase(0, 1);
 								modified = true;
 							}
 						}
@@ -1270,7 +1395,7 @@ void TextEditor::EnterCharacter(ImWchar aChar, bool aShift)
 				}
 				else
 				{
-					line.insert(line.begin(), Glyph('\t', TextEditor::PaletteIndex::Background));
+					line.Insert(0, "\t", 1);
 					modified = true;
 				}
 			}
@@ -1301,6 +1426,7 @@ void TextEditor::EnterCharacter(ImWchar aChar, bool aShift)
 				AddUndo(u);
 
 				mTextChanged = true;
+				Colorize(start.mLine, rangeEnd.mLine - start.mLine + 1);
 
 				EnsureCursorVisible();
 			}
@@ -1328,13 +1454,17 @@ void TextEditor::EnterCharacter(ImWchar aChar, bool aShift)
 		auto& newLine = mLines[coord.mLine + 1];
 
 		if (mLanguageDefinition.mAutoIndentation)
-			for (size_t it = 0; it < line.size() && isascii(line[it].mChar) && isblank(line[it].mChar); ++it)
-				newLine.push_back(line[it]);
+		{
+			int indent = 0;
+			while (indent < (int)line.size() && isascii(line[indent]) && isblank(line[indent]))
+				++indent;
+			newLine.Insert(0, line, 0, indent);
+		}
 
 		const size_t whitespaceSize = newLine.size();
 		auto cindex = GetCharacterIndex(coord);
-		newLine.insert(newLine.end(), line.begin() + cindex, line.end());
-		line.erase(line.begin() + cindex, line.begin() + line.size());
+		newLine.Insert((int)newLine.size(), line, cindex, (int)line.size());
+		line.Erase(cindex, (int)line.size());
 		SetCursorPosition(Coordinates(coord.mLine + 1, GetCharacterColumn(coord.mLine + 1, (int)whitespaceSize)));
 		u.mAdded = (char)aChar;
 	}
@@ -1350,20 +1480,18 @@ void TextEditor::EnterCharacter(ImWchar aChar, bool aShift)
 
 			if (mOverwrite && cindex < (int)line.size())
 			{
-				auto d = UTF8CharLength(line[cindex].mChar);
+				auto d = UTF8CharLength(line[cindex]);
 
 				u.mRemovedStart = mState.mCursorPosition;
 				u.mRemovedEnd = Coordinates(coord.mLine, GetCharacterColumn(coord.mLine, cindex + d));
 
-				while (d-- > 0 && cindex < (int)line.size())
-				{
-					u.mRemoved += line[cindex].mChar;
-					line.erase(line.begin() + cindex);
-				}
+				d = std::min(d, (int)line.size() - cindex);
+				u.mRemoved.append(line.data() + cindex, d);
+				line.Erase(cindex, cindex + d);
 			}
 
-			for (auto p = buf; *p != '\0'; p++, ++cindex)
-				line.insert(line.begin() + cindex, Glyph(*p, PaletteIndex::Default));
+			line.Insert(cindex, buf, e);
+			cindex += e;
 			u.mAdded = buf;
 
 			SetCursorPosition(Coordinates(coord.mLine, GetCharacterColumn(coord.mLine, cindex)));
@@ -1391,6 +1519,7 @@ void TextEditor::SetReadOnly(bool aValue)
 void TextEditor::SetColorizerEnable(bool aValue)
 {
 	mColorizerEnabled = aValue;
+	++mLayoutGeneration;
 }
 
 void TextEditor::SetCursorPosition(const Coordinates & aPosition)
@@ -1458,6 +1587,7 @@ void TextEditor::SetSelection(const Coordinates & aStart, const Coordinates & aE
 void TextEditor::SetTabSize(int aValue)
 {
 	mTabSize = std::max(0, std::min(32, aValue));
+	++mLayoutGeneration;
 }
 
 void TextEditor::InsertText(const std::string & aValue)
@@ -1584,7 +1714,7 @@ void TextEditor::MoveLeft(int aAmount, bool aSelect, bool aWordMode)
 			{
 				if ((int)mLines.size() > line)
 				{
-					while (cindex > 0 && IsUTFSequence(mLines[line][cindex].mChar))
+					while (cindex > 0 && IsUTFSequence(mLines[line][cindex]))
 						--cindex;
 				}
 			}
@@ -1645,7 +1775,7 @@ void TextEditor::MoveRight(int aAmount, bool aSelect, bool aWordMode)
 		}
 		else
 		{
-			cindex += UTF8CharLength(line[cindex].mChar);
+			cindex += UTF8CharLength(line[cindex]);
 			mState.mCursorPosition = Coordinates(lindex, GetCharacterColumn(lindex, cindex));
 			if (aWordMode)
 				mState.mCursorPosition = FindNextWord(mState.mCursorPosition);
@@ -1788,7 +1918,7 @@ void TextEditor::Delete()
 			Advance(u.mRemovedEnd);
 
 			auto& nextLine = mLines[pos.mLine + 1];
-			line.insert(line.end(), nextLine.begin(), nextLine.end());
+			line.Insert((int)line.size(), nextLine, 0, (int)nextLine.size());
 			RemoveLine(pos.mLine + 1);
 		}
 		else
@@ -1798,9 +1928,8 @@ void TextEditor::Delete()
 			u.mRemovedEnd.mColumn++;
 			u.mRemoved = GetText(u.mRemovedStart, u.mRemovedEnd);
 
-			auto d = UTF8CharLength(line[cindex].mChar);
-			while (d-- > 0 && cindex < (int)line.size())
-				line.erase(line.begin() + cindex);
+			auto d = UTF8CharLength(line[cindex]);
+			line.Erase(cindex, std::min(cindex + d, (int)line.size()));
 		}
 
 		mTextChanged = true;
@@ -1847,7 +1976,7 @@ void TextEditor::Backspace()
 			auto& line = mLines[mState.mCursorPosition.mLine];
 			auto& prevLine = mLines[mState.mCursorPosition.mLine - 1];
 			auto prevSize = GetLineMaxColumn(mState.mCursorPosition.mLine - 1);
-			prevLine.insert(prevLine.end(), line.begin(), line.end());
+			prevLine.Insert((int)prevLine.size(), line, 0, (int)line.size());
 
 			ErrorMarkers etmp;
 			for (auto& i : mErrorMarkers)
@@ -1863,20 +1992,21 @@ void TextEditor::Backspace()
 			auto& line = mLines[mState.mCursorPosition.mLine];
 			auto cindex = GetCharacterIndex(pos) - 1;
 			auto cend = cindex + 1;
-			while (cindex > 0 && IsUTFSequence(line[cindex].mChar))
+			while (cindex > 0 && IsUTFSequence(line[cindex]))
 				--cindex;
 
-			//if (cindex > 0 && UTF8CharLength(line[cindex].mChar) > 1)
+			//if (cindex > 0 && UTF8CharLength(line[cindex]) > 1)
 			//	--cindex;
 
 			u.mRemovedStart = u.mRemovedEnd = GetActualCursorCoordinates();
 			--u.mRemovedStart.mColumn;
 			--mState.mCursorPosition.mColumn;
 
-			while (cindex < line.size() && cend-- > cindex)
+			cend = std::min(cend, (int)line.size());
+			if (cindex < cend)
 			{
-				u.mRemoved += line[cindex].mChar;
-				line.erase(line.begin() + cindex);
+				u.mRemoved.append(line.data() + cindex, cend - cindex);
+				line.Erase(cindex, cend);
 			}
 		}
 
@@ -1916,10 +2046,8 @@ void TextEditor::Copy()
 	{
 		if (!mLines.empty())
 		{
-			std::string str;
 			auto& line = mLines[GetActualCursorCoordinates().mLine];
-			for (auto& g : line)
-				str.push_back(g.mChar);
+			std::string str(line.data(), line.size());
 			ImGui::SetClipboardText(str.c_str());
 		}
 	}
@@ -2092,23 +2220,30 @@ std::string TextEditor::GetText() const
 	return GetText(Coordinates(), Coordinates((int)mLines.size(), 0));
 }
 
-std::vector<std::string> TextEditor::GetTextLines() const
+void TextEditor::GetTextViews(std::vector<const char*>& aStrings, std::vector<int>& aLengths) const
 {
-	std::vector<std::string> result;
-
-	result.reserve(mLines.size());
+	aStrings.clear();
+	aLengths.clear();
+	aStrings.reserve(mLines.size() * 2);
+	aLengths.reserve(mLines.size() * 2);
 
 	for (auto & line : mLines)
 	{
-		std::string text;
+		aStrings.push_back(line.data());
+		aLengths.push_back((int)line.size());
+		aStrings.push_back("\n");
+		aLengths.push_back(1);
+	}
+}
 
-		text.resize(line.size());
+std::vector<std::string> TextEditor::GetTextLines() const
+{
+	std::vector<std::string> result;
 
-		for (size_t i = 0; i < line.size(); ++i)
-			text[i] = line[i].mChar;
+	result.reserve(mLines.size());
 
-		result.emplace_back(std::move(text));
-	}
+	for (auto & line : mLines)
+		result.emplace_back(line.data(), line.size());
 
 	return result;
 }
@@ -2137,17 +2272,153 @@ void TextEditor::Colorize(int aFromLine, int aLines)
 	mColorRangeMax = std::max(mColorRangeMax, toLine);
 	mColorRangeMin = std::max(0, mColorRangeMin);
 	mColorRangeMax = std::max(mColorRangeMin, mColorRangeMax);
+	mCommentRangeMin = std::max(0, std::min(mCommentRangeMin, aFromLine));
+	mCommentRangeMax = std::max(mCommentRangeMax, toLine);
 	mCheckComments = true;
 }
 
+// 64 bit FNV-1a, upper cased for case insensitive languages
+static uint64_t HashWord(const char * aBegin, const char * aEnd, bool aCaseSensitive)
+{
+	uint64_t h = 14695981039346656037ull;
+	for (auto p = aBegin; p != aEnd; ++p)
+	{
+		h ^= (uint8_t)(aCaseSensitive ? *p : toupper((uint8_t)*p));
+		h *= 1099511628211ull;
+	}
+	return h;
+}
+
+static uint32_t HashWordSlot(uint64_t aHash, uint32_t aSeed)
+{
+	uint64_t h = aHash ^ (aSeed * 0x9e3779b97f4a7c15ull);
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdull;
+	h ^= h >> 33;
+	return (uint32_t)h;
+}
+
+void TextEditor::WordTable::Build(const LanguageDefinition & aLanguageDef)
+{
+	mCaseSensitive = aLanguageDef.mCaseSensitive;
+
+	// identifiers are upper cased before the lookup in case insensitive languages,
+	// so words with lower case letters could never match there
+	std::map<std::string, uint8_t> words;
+	auto add = [&](const std::string& aWord, uint8_t aFlag)
+	{
+		if (mCaseSensitive || std::none_of(aWord.begin(), aWord.end(), [](char c) { return c >= 'a' && c <= 'z'; }))
+			words[aWord] |= aFlag;
+	};
+	for (auto& k : aLanguageDef.mKeywords)
+		add(k, KeywordFlag);
+	for (auto& k : aLanguageDef.mIdentifiers)
+		add(k.first, IdentifierFlag);
+	for (auto& k : aLanguageDef.mPreprocIdentifiers)
+		add(k.first, PreprocIdentifierFlag);
+
+	mChars.clear();
+	std::vector<Slot> entries;
+	std::vector<uint64_t> hashes;
+	for (auto& w : words)
+	{
+		Slot entry;
+		entry.mOffset = (uint32_t)mChars.size();
+		entry.mLength = (uint16_t)w.first.size();
+		entry.mFlags = w.second;
+		mChars.insert(mChars.end(), w.first.begin(), w.first.end());
+		entries.push_back(entry);
+		hashes.push_back(HashWord(w.first.data(), w.first.data() + w.first.size(), mCaseSensitive));
+	}
+
+	// Words are grouped into small buckets; each bucket gets the first seed that moves all of its
+	// words to free slots. Biggest buckets go first while the table is still empty.
+	size_t slotCount = 1;
+	while (slotCount < entries.size() * 2)
+		slotCount <<= 1;
+	std::vector<std::vector<uint32_t>> buckets(entries.size() / 4 + 1);
+	for (uint32_t i = 0; i < (uint32_t)entries.size(); ++i)
+		buckets[hashes[i] % buckets.size()].push_back(i);
+	std::vector<uint32_t> order(buckets.size());
+	for (uint32_t i = 0; i < (uint32_t)order.size(); ++i)
+		order[i] = i;
+	std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return buckets[a].size() > buckets[b].size(); });
+
+	for (;;)
+	{
+		mSlots.assign(slotCount, Slot());
+		mSeeds.assign(buckets.size(), 0);
+		std::vector<uint32_t> placed;
+		bool complete = true;
+		for (auto b : order)
+		{
+			auto& bucket = buckets[b];
+			if (bucket.empty())
+				break;
+			uint32_t seed = 0;
+			for (; seed < 1u << 16; ++seed)
+			{
+				placed.clear();
+				for (auto i : bucket)
+				{
+					auto slot = HashWordSlot(hashes[i], seed) & (uint32_t)(slotCount - 1);
+					if (mSlots[slot].mFlags != 0 || std::find(placed.begin(), placed.end(), slot) != placed.end())
+						break;
+					placed.push_back(slot);
+				}
+				if (placed.size() == bucket.size())
+					break;
+			}
+			if (placed.size() != bucket.size())
+			{
+				complete = false;
+				break;
+			}
+			mSeeds[b] = seed;
+			for (size_t j = 0; j < bucket.size(); ++j)
+				mSlots[placed[j]] = entries[bucket[j]];
+		}
+		if (complete)
+			break;
+		slotCount <<= 1;
+	}
+}
+
+TextEditor::PaletteIndex TextEditor::WordTable::Find(const char * aBegin, const char * aEnd, bool aPreprocessor) const
+{
+	auto hash = HashWord(aBegin, aEnd, mCaseSensitive);
+	auto seed = mSeeds[hash % mSeeds.size()];
+	auto& slot = mSlots[HashWordSlot(hash, seed) & (uint32_t)(mSlots.size() - 1)];
+	if (slot.mFlags == 0 || slot.mLength != aEnd - aBegin)
+		return PaletteIndex::Max;
+
+	auto word = mChars.data() + slot.mOffset;
+	for (size_t i = 0; i < slot.mLength; ++i)
+	{
+		auto c = mCaseSensitive ? aBegin[i] : (char)toupper((uint8_t)aBegin[i]);
+		if (c != word[i])
+			return PaletteIndex::Max;
+	}
+
+	if (!aPreprocessor)
+	{
+		if (slot.mFlags & KeywordFlag)
+			return PaletteIndex::Keyword;
+		if (slot.mFlags & IdentifierFlag)
+			return PaletteIndex::KnownIdentifier;
+	}
+	if (slot.mFlags & PreprocIdentifierFlag)
+		return PaletteIndex::PreprocIdentifier;
+	return PaletteIndex::Max;
+}
+
 void TextEditor::ColorizeRange(int aFromLine, int aToLine)
 {
 	if (mLines.empty() || aFromLine >= aToLine)
 		return;
 
-	std::string buffer;
 	std::cmatch results;
-	std::string id;
+	Line::Runs colors;
 
 	int endLine = std::max(0, std::min((int)mLines.size(), aToLine));
 	for (int i = aFromLine; i < endLine; ++i)
@@ -2157,16 +2428,11 @@ void TextEditor::ColorizeRange(int aFromLine, int aToLine)
 		if (line.empty())
 			continue;
 
-		buffer.resize(line.size());
-		for (size_t j = 0; j < line.size(); ++j)
-		{
-			auto& col = line[j];
-			buffer[j] = col.mChar;
-			col.mColorIndex = PaletteIndex::Default;
-		}
+		// tokens are read straight from the line, glyphs outside of them are Default
+		colors.clear();
 
-		const char * bufferBegin = &buffer.front();
-		const char * bufferEnd = bufferBegin + buffer.size();
+		const char * bufferBegin = line.data();
+		const char * bufferEnd = bufferBegin + line.size();
 
 		auto last = bufferEnd;
 
@@ -2210,165 +2476,171 @@ void TextEditor::ColorizeRange(int aFromLine, int aToLine)
 			}
 			else
 			{
-				const size_t token_length = token_end - token_begin;
-
 				if (token_color == PaletteIndex::Identifier)
 				{
-					id.assign(token_begin, token_end);
-
 					// todo : allmost all language definitions use lower case to specify keywords, so shouldn't this use ::tolower ?
-					if (!mLanguageDefinition.mCaseSensitive)
-						std::transform(id.begin(), id.end(), id.begin(), ::toupper);
-
-					if (!line[first - bufferBegin].mPreprocessor)
-					{
-						if (mLanguageDefinition.mKeywords.count(id) != 0)
-							token_color = PaletteIndex::Keyword;
-						else if (mLanguageDefinition.mIdentifiers.count(id) != 0)
-							token_color = PaletteIndex::KnownIdentifier;
-						else if (mLanguageDefinition.mPreprocIdentifiers.count(id) != 0)
-							token_color = PaletteIndex::PreprocIdentifier;
-					}
-					else
-					{
-						if (mLanguageDefinition.mPreprocIdentifiers.count(id) != 0)
-							token_color = PaletteIndex::PreprocIdentifier;
-					}
+					auto preprocessor = (line.GetFlags((int)(first - bufferBegin)) & Line::PreprocessorFlag) != 0;
+					auto known = mWordTable.Find(token_begin, token_end, preprocessor);
+					if (known != PaletteIndex::Max)
+						token_color = known;
 				}
 
-				for (size_t j = 0; j < token_length; ++j)
-					line[(token_begin - bufferBegin) + j].mColorIndex = token_color;
+				PushRun(colors, (int)(token_begin - bufferBegin), (uint8_t)token_color);
+				if (token_end != last)
+					PushRun(colors, (int)(token_end - bufferBegin), (uint8_t)PaletteIndex::Default);
 
 				first = token_end;
 			}
 		}
+
+		line.SetColorRuns(colors);
 	}
 }
 
-void TextEditor::ColorizeInternal()
+TextEditor::LineState TextEditor::ScanLineState(int aLine, LineState aState, Line::Runs& aFlags)
 {
-	if (mLines.empty() || !mColorizerEnabled)
-		return;
+	auto& line = mLines[aLine];
 
-	if (mCheckComments)
+	if (!aState.mConcatenate)
 	{
-		auto endLine = mLines.size();
-		auto endIndex = 0;
-		auto commentStartLine = endLine;
-		auto commentStartIndex = endIndex;
-		auto withinString = false;
-		auto withinSingleLineComment = false;
-		auto withinPreproc = false;
-		auto firstChar = true;			// there is no other non-whitespace characters in the line before
-		auto concatenate = false;		// '\' on the very end of the line
-		auto currentLine = 0;
-		auto currentIndex = 0;
-		while (currentLine < endLine || currentIndex < endIndex)
-		{
-			auto& line = mLines[currentLine];
-
-			if (currentIndex == 0 && !concatenate)
-			{
-				withinSingleLineComment = false;
-				withinPreproc = false;
-				firstChar = true;
-			}
+		aState.mSingleLineComment = false;
+		aState.mPreprocessor = false;
+		aState.mFirstChar = true;
+	}
+	aState.mConcatenate = false;
 
-			concatenate = false;
+	// a comment opened on an earlier line covers the line from its first glyph
+	const int noComment = std::numeric_limits<int>::max();
+	int commentStartIndex = aState.mMultiLineComment ? 0 : noComment;
+	auto flagsOf = [&](bool aComment, bool aInComment)
+	{
+		return (uint8_t)((aComment ? Line::CommentFlag : 0) |
+			(aInComment ? Line::MultiLineCommentFlag : 0) |
+			(aState.mPreprocessor ? Line::PreprocessorFlag : 0));
+	};
+	auto pred = [](const char& a, const char& b) { return a == b; };
+	aFlags.clear();
 
-			if (!line.empty())
-			{
-				auto& g = line[currentIndex];
-				auto c = g.mChar;
+	int currentIndex = 0;
+	while (currentIndex < (int)line.size())
+	{
+		const int glyphIndex = currentIndex;
+		auto c = line[currentIndex];
+		bool comment = false;
+		bool skipped = false;	// a string escape took the next glyph along
 
-				if (c != mLanguageDefinition.mPreprocChar && !isspace(c))
-					firstChar = false;
+		if (c != mLanguageDefinition.mPreprocChar && !isspace(c))
+			aState.mFirstChar = false;
 
-				if (currentIndex == (int)line.size() - 1 && line[line.size() - 1].mChar == '\\')
-					concatenate = true;
+		aState.mConcatenate = currentIndex == (int)line.size() - 1 && line[line.size() - 1] == '\\';
 
-				bool inComment = (commentStartLine < currentLine || (commentStartLine == currentLine && commentStartIndex <= currentIndex));
+		bool inComment = commentStartIndex <= currentIndex;
 
-				if (withinString)
+		if (aState.mString)
+		{
+			if (c == '\"')
+			{
+				if (currentIndex + 1 < (int)line.size() && line[currentIndex + 1] == '\"')
 				{
-					line[currentIndex].mMultiLineComment = inComment;
-
-					if (c == '\"')
-					{
-						if (currentIndex + 1 < (int)line.size() && line[currentIndex + 1].mChar == '\"')
-						{
-							currentIndex += 1;
-							if (currentIndex < (int)line.size())
-								line[currentIndex].mMultiLineComment = inComment;
-						}
-						else
-							withinString = false;
-					}
-					else if (c == '\\')
-					{
-						currentIndex += 1;
-						if (currentIndex < (int)line.size())
-							line[currentIndex].mMultiLineComment = inComment;
-					}
+					currentIndex += 1;
+					skipped = currentIndex < (int)line.size();
 				}
 				else
-				{
-					if (firstChar && c == mLanguageDefinition.mPreprocChar)
-						withinPreproc = true;
+					aState.mString = false;
+			}
+			else if (c == '\\')
+			{
+				currentIndex += 1;
+				skipped = currentIndex < (int)line.size();
+			}
+		}
+		else
+		{
+			if (aState.mFirstChar && c == mLanguageDefinition.mPreprocChar)
+				aState.mPreprocessor = true;
 
-					if (c == '\"')
-					{
-						withinString = true;
-						line[currentIndex].mMultiLineComment = inComment;
-					}
-					else
-					{
-						auto pred = [](const char& a, const Glyph& b) { return a == b.mChar; };
-						auto from = line.begin() + currentIndex;
-						auto& startStr = mLanguageDefinition.mCommentStart;
-						auto& singleStartStr = mLanguageDefinition.mSingleLineComment;
-
-						if (singleStartStr.size() > 0 &&
-							currentIndex + singleStartStr.size() <= line.size() &&
-							equals(singleStartStr.begin(), singleStartStr.end(), from, from + singleStartStr.size(), pred))
-						{
-							withinSingleLineComment = true;
-						}
-						else if (!withinSingleLineComment && currentIndex + startStr.size() <= line.size() &&
-							equals(startStr.begin(), startStr.end(), from, from + startStr.size(), pred))
-						{
-							commentStartLine = currentLine;
-							commentStartIndex = currentIndex;
-						}
+			if (c == '\"')
+				aState.mString = true;
+			else
+			{
+				auto from = line.data() + currentIndex;
+				auto& startStr = mLanguageDefinition.mCommentStart;
+				auto& singleStartStr = mLanguageDefinition.mSingleLineComment;
 
-						inComment = inComment = (commentStartLine < currentLine || (commentStartLine == currentLine && commentStartIndex <= currentIndex));
+				if (singleStartStr.size() > 0 &&
+					currentIndex + singleStartStr.size() <= line.size() &&
+					equals(singleStartStr.begin(), singleStartStr.end(), from, from + singleStartStr.size(), pred))
+				{
+					aState.mSingleLineComment = true;
+				}
+				else if (!aState.mSingleLineComment && currentIndex + startStr.size() <= line.size() &&
+					equals(startStr.begin(), startStr.end(), from, from + startStr.size(), pred))
+				{
+					commentStartIndex = currentIndex;
+				}
 
-						line[currentIndex].mMultiLineComment = inComment;
-						line[currentIndex].mComment = withinSingleLineComment;
+				inComment = commentStartIndex <= currentIndex;
+				comment = aState.mSingleLineComment;
 
-						auto& endStr = mLanguageDefinition.mCommentEnd;
-						if (currentIndex + 1 >= (int)endStr.size() &&
-							equals(endStr.begin(), endStr.end(), from + 1 - endStr.size(), from + 1, pred))
-						{
-							commentStartIndex = endIndex;
-							commentStartLine = endLine;
-						}
-					}
-				}
-				line[currentIndex].mPreprocessor = withinPreproc;
-				currentIndex += UTF8CharLength(c);
-				if (currentIndex >= (int)line.size())
+				auto& endStr = mLanguageDefinition.mCommentEnd;
+				if (currentIndex + 1 >= (int)endStr.size() &&
+					equals(endStr.begin(), endStr.end(), from + 1 - endStr.size(), from + 1, pred))
 				{
-					currentIndex = 0;
-					++currentLine;
+					commentStartIndex = noComment;
 				}
 			}
-			else
-			{
-				currentIndex = 0;
-				++currentLine;
-			}
 		}
+
+		// every glyph gets all three flags, strings would otherwise keep the ones from before an edit
+		PushRun(aFlags, glyphIndex, flagsOf(comment, inComment));
+		if (skipped)
+			PushRun(aFlags, currentIndex, flagsOf(false, inComment));
+		currentIndex += UTF8CharLength(c);
+	}
+	line.SetFlagRuns(aFlags);
+
+	aState.mMultiLineComment = commentStartIndex != noComment;
+	if (!aState.mConcatenate)
+	{
+		// dropped at the next line start anyway, cleared so that states compare equal
+		aState.mSingleLineComment = false;
+		aState.mPreprocessor = false;
+		aState.mFirstChar = true;
+	}
+	return aState;
+}
+
+void TextEditor::ColorizeInternal()
+{
+	if (mLines.empty() || !mColorizerEnabled)
+		return;
+
+	if (mCheckComments)
+	{
+		const int lineCount = (int)mLines.size();
+		if (mLineStates.size() != mLines.size())
+		{
+			mLineStates.assign(mLines.size(), LineState());
+			mCommentRangeMin = 0;
+			mCommentRangeMax = lineCount;
+		}
+
+		// Lines before the first edited one are unchanged, so is the state at its start. Past the
+		// edited lines the scan stops at the first line whose start state comes out as before.
+		int currentLine = std::min(mCommentRangeMin, lineCount - 1);
+		LineState state = mLineStates[currentLine];
+		Line::Runs flags;
+		for (; currentLine < lineCount; ++currentLine)
+		{
+			mLineStates[currentLine] = state;
+			state = ScanLineState(currentLine, state, flags);
+
+			if (currentLine + 1 >= mCommentRangeMax && currentLine + 1 < lineCount && mLineStates[currentLine + 1] == state)
+				break;
+		}
+
+		mCommentRangeMin = std::numeric_limits<int>::max();
+		mCommentRangeMax = 0;
 		mCheckComments = false;
 	}
 
@@ -2388,33 +2660,160 @@ void TextEditor::ColorizeInternal()
 	}
 }
 
-float TextEditor::TextDistanceToLineStart(const Coordinates& aFrom) const
+float TextEditor::TextDistanceToLineStart(const Coordinates& aFrom)
 {
-	auto& line = mLines[aFrom.mLine];
-	float distance = 0.0f;
-	float spaceSize = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, " ", nullptr, nullptr).x;
-	int colIndex = GetCharacterIndex(aFrom);
-	for (size_t it = 0u; it < line.size() && it < colIndex; )
-	{
-		if (line[it].mChar == '\t')
-		{
-			distance = (1.0f + std::floor((1.0f + distance) / (float(mTabSize) * spaceSize))) * (float(mTabSize) * spaceSize);
-			++it;
-		}
-		else
-		{
-			auto d = UTF8CharLength(line[it].mChar);
-			char tempCString[7];
-			int i = 0;
-			for (; i < 6 && d-- > 0 && it < (int)line.size(); i++, it++)
-				tempCString[i] = line[it].mChar;
+	return FindLayoutGlyph(GetLineLayout(aFrom.mLine), aFrom.mColumn)->mX;
+}
+
+// The first glyph starting at or after the column, as GetCharacterIndex finds it, or the line end
+const TextEditor::LineLayout::Glyph* TextEditor::FindLayoutGlyph(const LineLayout& aLayout, int aColumn)
+{
+	auto& glyphs = aLayout.mGlyphs;
+	return &*std::lower_bound(glyphs.begin(), glyphs.end() - 1, aColumn,
+		[](const LineLayout::Glyph& aGlyph, int aValue) { return aGlyph.mColumn < aValue; });
+}
+
+const TextEditor::LineLayout& TextEditor::GetLineLayout(int aLine)
+{
+	if (mLineLayouts.empty())
+		mLineLayouts.resize(64);
+
+	auto& line = mLines[aLine];
+	auto& layout = mLineLayouts[aLine & (mLineLayouts.size() - 1)];
+
+	if (layout.mGlyphs.empty() || layout.mStamp != line.GetStamp() || layout.mGeneration != mLayoutGeneration)
+	{
+		// A new generation may come with a new font, the line number width is measured with it
+		if (layout.mGeneration != mLayoutGeneration)
+			layout.mLineNumber = 0;
+		layout.mStamp = line.GetStamp();
+		layout.mGeneration = mLayoutGeneration;
+		layout.mGlyphs.clear();
+		layout.mSpans.clear();
+
+		auto tabWidth = float(mTabSize) * GetGlyphAdvance(" ", 1);
+		auto& colorRuns = line.GetColorRuns();
+		auto& flagRuns = line.GetFlagRuns();
+		size_t colorRun = 0;
+		size_t flagRun = 0;
+		auto colorIndex = PaletteIndex::Default;
+		uint8_t flags = 0;
+
+		float x = 0.0f;
+		int column = 0;
+		bool spanOpen = false;
+		for (int i = 0; i < (int)line.size();)
+		{
+			while (colorRun < colorRuns.size() && colorRuns[colorRun].mStart <= i)
+				colorIndex = (PaletteIndex)colorRuns[colorRun++].mValue;
+			while (flagRun < flagRuns.size() && flagRuns[flagRun].mStart <= i)
+				flags = flagRuns[flagRun++].mValue;
+
+			auto c = line[i];
+			auto length = std::min(UTF8CharLength(c), (int)line.size() - i);
+			layout.mGlyphs.push_back({ i, column, x });
+
+			if (c == '\t')
+			{
+				x = (1.0f + std::floor((1.0f + x) / tabWidth)) * tabWidth;
+				column = (column / mTabSize) * mTabSize + mTabSize;
+				spanOpen = false;
+				i += length;
+				continue;
+			}
+
+			auto advance = GetGlyphAdvance(line.data() + i, length);
+
+			// Spaces go into whichever span they fall in, other glyphs only into one of their color
+			if (c != ' ')
+			{
+				auto spanColor = PaletteIndex::Default;
+				uint8_t spanFlags = 0;
+				if (mColorizerEnabled)
+				{
+					if (flags & Line::CommentFlag)
+						spanColor = PaletteIndex::Comment;
+					else if (flags & Line::MultiLineCommentFlag)
+						spanColor = PaletteIndex::MultiLineComment;
+					else
+					{
+						spanColor = colorIndex;
+						spanFlags = flags & Line::PreprocessorFlag;
+					}
+				}
+
+				if (!spanOpen || layout.mSpans.back().mColorIndex != spanColor || layout.mSpans.back().mFlags != spanFlags)
+					layout.mSpans.push_back({ i, i, x, x, spanColor, spanFlags });
+				layout.mSpans.back().mEnd = i + length;
+				layout.mSpans.back().mEndX = x + advance;
+				spanOpen = true;
+			}
 
-			tempCString[i] = '\0';
-			distance += ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, tempCString, nullptr, nullptr).x;
+			x += advance;
+			++column;
+			i += length;
 		}
+		layout.mGlyphs.push_back({ (int)line.size(), column, x });
 	}
 
-	return distance;
+	if (layout.mLineNumber != aLine + 1)
+	{
+		layout.mLineNumber = aLine + 1;
+		snprintf(layout.mLineNumberText, sizeof(layout.mLineNumberText), "%d  ", layout.mLineNumber);
+		layout.mLineNumberWidth = GetTextWidth(layout.mLineNumberText, layout.mLineNumberText + strlen(layout.mLineNumberText));
+	}
+
+	return layout;
+}
+
+void TextEditor::UpdateGlyphAdvances()
+{
+	auto font = ImGui::GetFont();
+	auto fontSize = ImGui::GetFontSize();
+	if (font == mAdvanceFont && fontSize == mAdvanceFontSize)
+		return;
+
+	mAdvanceFont = font;
+	mAdvanceFontSize = fontSize;
+	for (int c = 0; c < (int)mAsciiAdvances.size(); ++c)
+	{
+		char glyph = (char)c;
+		mAsciiAdvances[c] = font->CalcTextSizeA(fontSize, FLT_MAX, -1.0f, &glyph, &glyph + 1).x;
+	}
+	mGlyphAdvances.clear();
+	++mLayoutGeneration;
+}
+
+float TextEditor::GetGlyphAdvance(const char* aGlyph, int aLength)
+{
+	auto c = (Char)aGlyph[0];
+	if (c < mAsciiAdvances.size())
+		return mAsciiAdvances[c];
+	if (aLength > 4)
+		return mAdvanceFont->CalcTextSizeA(mAdvanceFontSize, FLT_MAX, -1.0f, aGlyph, aGlyph + aLength).x;
+
+	// Continuation bytes are never zero, so the bytes alone tell the lengths apart
+	uint32_t key = 0;
+	memcpy(&key, aGlyph, aLength);
+	auto it = mGlyphAdvances.find(key);
+	if (it != mGlyphAdvances.end())
+		return it->second;
+
+	auto advance = mAdvanceFont->CalcTextSizeA(mAdvanceFontSize, FLT_MAX, -1.0f, aGlyph, aGlyph + aLength).x;
+	mGlyphAdvances.emplace(key, advance);
+	return advance;
+}
+
+float TextEditor::GetTextWidth(const char* aBegin, const char* aEnd)
+{
+	float width = 0.0f;
+	while (aBegin < aEnd)
+	{
+		auto length = std::min(UTF8CharLength((Char)*aBegin), (int)(aEnd - aBegin));
+		width += GetGlyphAdvance(aBegin, length);
+		aBegin += length;
+	}
+	return width;
 }
 
 void TextEditor::EnsureCursorVisible()
@@ -2503,14 +2902,14 @@ void TextEditor::UndoRecord::Redo(TextEditor * aEditor)
 	if (!mRemoved.empty())
 	{
 		aEditor->DeleteRange(mRemovedStart, mRemovedEnd);
-		aEditor->Colorize(mRemovedStart.mLine - 1, mRemovedEnd.mLine - mRemovedStart.mLine + 1);
+		aEditor->Colorize(mRemovedStart.mLine - 1, mRemovedEnd.mLine - mRemovedStart.mLine + 2);
 	}
 
 	if (!mAdded.empty())
 	{
 		auto start = mAddedStart;
 		aEditor->InsertTextAt(start, mAdded.c_str());
-		aEditor->Colorize(mAddedStart.mLine - 1, mAddedEnd.mLine - mAddedStart.mLine + 1);
+		aEditor->Colorize(mAddedStart.mLine - 1, mAddedEnd.mLine - mAddedStart.mLine + 2);
 	}
 
 	aEditor->mState = mAfter;
@@ -2734,6 +3133,150 @@ static bool TokenizeCStylePunctuation(const char * in_begin, const char * in_end
 	return false;
 }
 
+static bool TokenizeCStylePreprocessorDirective(const char * in_begin, const char * in_end, const char *& out_begin, const char *& out_end)
+{
+	const char * p = in_begin;
+
+	if (*p != '#')
+		return false;
+
+	p++;
+
+	while (p < in_end && isascii(*p) && isblank(*p))
+		p++;
+
+	const char * name = p;
+
+	while (p < in_end && ((*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z') || *p == '_'))
+		p++;
+
+	if (p == name)
+		return false;
+
+	out_begin = in_begin;
+	out_end = p;
+	return true;
+}
+
+static bool TokenizeShaderNumber(const char * in_begin, const char * in_end, const char *& out_begin, const char *& out_end)
+{
+	const char * p = in_begin;
+
+	if (p + 1 < in_end && p[0] == '0' && (p[1] == 'x' || p[1] == 'X'))
+	{
+		// hex formatted integer of the type 0xff00u
+		p += 2;
+
+		const char * digits = p;
+
+		while (p < in_end && ((*p >= '0' && *p <= '9') || (*p >= 'a' && *p <= 'f') || (*p >= 'A' && *p <= 'F')))
+			p++;
+
+		if (p == digits)
+			return false;
+
+		if (p < in_end && (*p == 'u' || *p == 'U'))
+			p++;
+
+		out_begin = in_begin;
+		out_end = p;
+		return true;
+	}
+
+	// a sign belongs to the expression, not the literal: "a-1.0" is three tokens
+	bool hasDigits = false;
+	bool isFloat = false;
+
+	while (p < in_end && (*p >= '0' && *p <= '9'))
+	{
+		hasDigits = true;
+		p++;
+	}
+
+	// ".5" and "2." are both floats
+	if (p < in_end && *p == '.')
+	{
+		const char * fraction = p + 1;
+
+		while (fraction < in_end && (*fraction >= '0' && *fraction <= '9'))
+			fraction++;
+
+		if (hasDigits || fraction > p + 1)
+		{
+			hasDigits = true;
+			isFloat = true;
+			p = fraction;
+		}
+	}
+
+	if (hasDigits == false)
+		return false;
+
+	// floating point exponent, left for the next token when it has no digits
+	if (p < in_end && (*p == 'e' || *p == 'E'))
+	{
+		const char * exponent = p + 1;
+
+		if (exponent < in_end && (*exponent == '+' || *exponent == '-'))
+			exponent++;
+
+		const char * digits = exponent;
+
+		while (exponent < in_end && (*exponent >= '0' && *exponent <= '9'))
+			exponent++;
+
+		if (exponent > digits)
+		{
+			isFloat = true;
+			p = exponent;
+		}
+	}
+
+	// f, h (HLSL half), lf (GLSL double) on floats, u on integers
+	if (p < in_end)
+	{
+		if (*p == 'f' || *p == 'F' || *p == 'h' || *p == 'H')
+			p++;
+		else if (isFloat && p + 1 < in_end && (*p == 'l' || *p == 'L') && (p[1] == 'f' || p[1] == 'F'))
+			p += 2;
+		else if (!isFloat && (*p == 'u' || *p == 'U'))
+			p++;
+	}
+
+	out_begin = in_begin;
+	out_end = p;
+	return true;
+}
+
+static bool TokenizeShader(const char * in_begin, const char * in_end, const char *& out_begin, const char *& out_end, TextEditor::PaletteIndex & paletteIndex)
+{
+	paletteIndex = TextEditor::PaletteIndex::Max;
+
+	while (in_begin < in_end && isascii(*in_begin) && isblank(*in_begin))
+		in_begin++;
+
+	if (in_begin == in_end)
+	{
+		out_begin = in_end;
+		out_end = in_end;
+		paletteIndex = TextEditor::PaletteIndex::Default;
+	}
+	else if (TokenizeCStylePreprocessorDirective(in_begin, in_end, out_begin, out_end))
+		paletteIndex = TextEditor::PaletteIndex::Preprocessor;
+	else if (TokenizeCStyleString(in_begin, in_end, out_begin, out_end))
+		paletteIndex = TextEditor::PaletteIndex::String;
+	else if (TokenizeCStyleCharacterLiteral(in_begin, in_end, out_begin, out_end))
+		paletteIndex = TextEditor::PaletteIndex::CharLiteral;
+	else if (TokenizeCStyleIdentifier(in_begin, in_end, out_begin, out_end))
+		paletteIndex = TextEditor::PaletteIndex::Identifier;
+	else if (TokenizeShaderNumber(in_begin, in_end, out_begin, out_end))
+		paletteIndex = TextEditor::PaletteIndex::Number;
+	else if (TokenizeCStylePunctuation(in_begin, in_end, out_begin, out_end))
+		paletteIndex = TextEditor::PaletteIndex::Punctuation;
+
+	return paletteIndex != TextEditor::PaletteIndex::Max;
+}
+
 const TextEditor::LanguageDefinition& TextEditor::LanguageDefinition::CPlusPlus()
 {
 	static bool inited = false;
@@ -2851,15 +3394,7 @@ const TextEditor::LanguageDefinition& TextEditor::LanguageDefinition::HLSL()
 			langDef.mIdentifiers.insert(std::make_pair(std::string(k), id));
 		}
 
-		langDef.mTokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("[ \\t]*#[ \\t]*[a-zA-Z_]+", PaletteIndex::Preprocessor));
-		langDef.mTokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("L?\\\"(\\\\.|[^\\\"])*\\\"", PaletteIndex::String));
-		langDef.mTokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("\\'\\\\?[^\\']\\'", PaletteIndex::CharLiteral));
-		langDef.mTokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("[+-]?([0-9]+([.][0-9]*)?|[.][0-9]+)([eE][+-]?[0-9]+)?[fF]?", PaletteIndex::Number));
-		langDef.mTokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("[+-]?[0-9]+[Uu]?[lL]?[lL]?", PaletteIndex::Number));
-		langDef.mTokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("0[0-7]+[Uu]?[lL]?[lL]?", PaletteIndex::Number));
-		langDef.mTokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("0[xX][0-9a-fA-F]+[uU]?[lL]?[lL]?", PaletteIndex::Number));
-		langDef.mTokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("[a-zA-Z_][a-zA-Z0-9_]*", PaletteIndex::Identifier));
-		langDef.mTokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("[\\[\\]\\{\\}\\!\\%\\^\\&\\*\\(\\)\\-\\+\\=\\~\\|\\<\\>\\?\\/\\;\\,\\.]", PaletteIndex::Punctuation));
+		langDef.mTokenize = TokenizeShader;
 
 		langDef.mCommentStart = "/*";
 		langDef.mCommentEnd = "*/";
@@ -2900,15 +3435,7 @@ const TextEditor::LanguageDefinition& TextEditor::LanguageDefinition::GLSL()
 			langDef.mIdentifiers.insert(std::make_pair(std::string(k), id));
 		}
 
-		langDef.mTokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("[ \\t]*#[ \\t]*[a-zA-Z_]+", PaletteIndex::Preprocessor));
-		langDef.mTokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("L?\\\"(\\\\.|[^\\\"])*\\\"", PaletteIndex::String));
-		langDef.mTokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("\\'\\\\?[^\\']\\'", PaletteIndex::CharLiteral));
-		langDef.mTokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("[+-]?([0-9]+([.][0-9]*)?|[.][0-9]+)([eE][+-]?[0-9]+)?[fF]?", PaletteIndex::Number));
-		langDef.mTokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("[+-]?[0-9]+[Uu]?[lL]?[lL]?", PaletteIndex::Number));
-		langDef.mTokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("0[0-7]+[Uu]?[lL]?[lL]?", PaletteIndex::Number));
-		langDef.mTokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("0[xX][0-9a-fA-F]+[uU]?[lL]?[lL]?", PaletteIndex::Number));
-		langDef.mTokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("[a-zA-Z_][a-zA-Z0-9_]*", PaletteIndex::Identifier));
-		langDef.mTokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("[\\[\\]\\{\\}\\!\\%\\^\\&\\*\\(\\)\\-\\+\\=\\~\\|\\<\\>\\?\\/\\;\\,\\.]", PaletteIndex::Punctuation));
+		langDef.mTokenize = TokenizeShader;
 
 		langDef.mCommentStart = "/*";
 		langDef.mCommentEnd = "*/";
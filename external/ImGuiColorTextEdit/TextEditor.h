@@ -133,19 +133,55 @@ public:
 	typedef std::array<ImU32, (unsigned)PaletteIndex::Max> Palette;
 	typedef uint8_t Char;
 
-	struct Glyph
+	// One line of text: the raw UTF-8 bytes, with the highlighting kept apart as runs of
+	// glyphs that share a color index or a set of flags.
+	class Line
 	{
-		Char mChar;
-		PaletteIndex mColorIndex = PaletteIndex::Default;
-		bool mComment : 1;
-		bool mMultiLineComment : 1;
-		bool mPreprocessor : 1;
-
-		Glyph(Char aChar, PaletteIndex aColorIndex) : mChar(aChar), mColorIndex(aColorIndex),
-			mComment(false), mMultiLineComment(false), mPreprocessor(false) {}
+	public:
+		enum : uint8_t
+		{
+			CommentFlag = 1,
+			MultiLineCommentFlag = 2,
+			PreprocessorFlag = 4
+		};
+
+		// A run covers the glyphs up to the start of the next one; glyphs before the first run are 0
+		struct Run
+		{
+			int mStart;
+			uint8_t mValue;
+		};
+		typedef std::vector<Run> Runs;
+
+		size_t size() const { return mChars.size(); }
+		bool empty() const { return mChars.empty(); }
+		Char operator[](size_t aIndex) const { return (Char)mChars[aIndex]; }
+		const char* data() const { return mChars.data(); }
+
+		// Inserted glyphs are Default and have no flags, copied ones keep their highlighting.
+		void Insert(int aIndex, const char* aChars, int aCount);
+		void Insert(int aIndex, const Line& aFrom, int aBegin, int aEnd);
+		void Erase(int aBegin, int aEnd);
+
+		PaletteIndex GetColorIndex(int aIndex) const;
+		uint8_t GetFlags(int aIndex) const;
+		const Runs& GetColorRuns() const { return mColors; }
+		const Runs& GetFlagRuns() const { return mFlags; }
+
+		// Replace the highlighting with runs built front to back over the whole line.
+		void SetColorRuns(const Runs& aRuns);
+		void SetFlagRuns(const Runs& aRuns);
+
+		// Changes with every edit or highlighting change, for caches built from the line
+		uint64_t GetStamp() const { return mStamp; }
+
+	private:
+		std::string mChars;
+		Runs mColors;
+		Runs mFlags;
+		uint64_t mStamp = 0;
 	};
 
-	typedef std::vector<Glyph> Line;
 	typedef std::vector<Line> Lines;
 
 	struct LanguageDefinition
@@ -198,6 +234,10 @@ public:
 	void SetText(const std::string& aText);
 	std::string GetText() const;
 
+	// The text as GetText() returns it, but handed out as one string per line and line
+	// break so it can go straight to glShaderSource without a copy. Valid until the next edit.
+	void GetTextViews(std::vector<const char*>& aStrings, std::vector<int>& aLengths) const;
+
 	void SetTextLines(const std::vector<std::string>& aLines);
 	std::vector<std::string> GetTextLines() const;
 
@@ -215,6 +255,9 @@ public:
 	bool IsColorizerEnabled() const { return mColorizerEnabled; }
 	void SetColorizerEnable(bool aValue);
 
+	// Highlighting is brought up to date over the following Render calls while this is true.
+	bool IsColorizing() const { return mColorizerEnabled && (mCheckComments || mColorRangeMin < mColorRangeMax); }
+
 	Coordinates GetCursorPosition() const { return GetActualCursorCoordinates(); }
 	void SetCursorPosition(const Coordinates& aPosition);
 
@@ -256,6 +299,7 @@ public:
 	void Cut();
 	void Paste();
 	void Delete();
+	void Backspace();
 
 	bool CanUndo() const;
 	bool CanRedo() const;
@@ -269,6 +313,37 @@ public:
 private:
 	typedef std::vector<std::pair<std::regex, PaletteIndex>> RegexList;
 
+	// Collision-free hash (hash and displace) over the keywords and known identifiers of
+	// the current language, so identifier tokens are classified without building a string.
+	class WordTable
+	{
+	public:
+		void Build(const LanguageDefinition& aLanguageDef);
+
+		// Keyword, KnownIdentifier, PreprocIdentifier or Max when the word is unknown.
+		PaletteIndex Find(const char* aBegin, const char* aEnd, bool aPreprocessor) const;
+
+	private:
+		enum : uint8_t
+		{
+			KeywordFlag = 1,
+			IdentifierFlag = 2,
+			PreprocIdentifierFlag = 4
+		};
+
+		struct Slot
+		{
+			uint32_t mOffset = 0;
+			uint16_t mLength = 0;
+			uint8_t mFlags = 0;
+		};
+
+		std::vector<char> mChars;
+		std::vector<Slot> mSlots;
+		std::vector<uint32_t> mSeeds;	// per bucket
+		bool mCaseSensitive = true;
+	};
+
 	struct EditorState
 	{
 		Coordinates mSelectionStart;
@@ -311,11 +386,69 @@ private:
 
 	typedef std::vector<UndoRecord> UndoBuffer;
 
+	// Where the glyphs of a line are drawn and how few AddText calls draw them, for the font,
+	// tab size and highlighting it was built with.
+	struct LineLayout
+	{
+		struct Glyph
+		{
+			int mIndex;
+			int mColumn;
+			float mX;
+		};
+
+		// Glyphs of one color with no tab in between, spaces included
+		struct Span
+		{
+			int mBegin, mEnd;
+			float mX, mEndX;
+			PaletteIndex mColorIndex;
+			uint8_t mFlags;
+		};
+
+		uint64_t mStamp = 0;
+		uint32_t mGeneration = 0;
+		std::vector<Glyph> mGlyphs;		// one per glyph, then one for the line end
+		std::vector<Span> mSpans;
+
+		int mLineNumber = 0;
+		char mLineNumberText[16];
+		float mLineNumberWidth = 0.0f;
+	};
+
+	// Comment/string/preprocessor state of the lexer at the start of a line
+	struct LineState
+	{
+		bool mMultiLineComment = false;
+		bool mString = false;
+		bool mConcatenate = false;		// previous line ended with '\', the next three carry over
+		bool mSingleLineComment = false;
+		bool mPreprocessor = false;
+		bool mFirstChar = true;
+
+		bool operator ==(const LineState& o) const
+		{
+			return
+				mMultiLineComment == o.mMultiLineComment &&
+				mString == o.mString &&
+				mConcatenate == o.mConcatenate &&
+				mSingleLineComment == o.mSingleLineComment &&
+				mPreprocessor == o.mPreprocessor &&
+				mFirstChar == o.mFirstChar;
+		}
+	};
+
 	void ProcessInputs();
 	void Colorize(int aFromLine = 0, int aCount = -1);
 	void ColorizeRange(int aFromLine = 0, int aToLine = 0);
 	void ColorizeInternal();
-	float TextDistanceToLineStart(const Coordinates& aFrom) const;
+	LineState ScanLineState(int aLine, LineState aState, Line::Runs& aFlags);	// aFlags is scratch space
+	float TextDistanceToLineStart(const Coordinates& aFrom);
+	static const LineLayout::Glyph* FindLayoutGlyph(const LineLayout& aLayout, int aColumn);
+	const LineLayout& GetLineLayout(int aLine);
+	void UpdateGlyphAdvances();
+	float GetGlyphAdvance(const char* aGlyph, int aLength);
+	float GetTextWidth(const char* aBegin, const char* aEnd);
 	void EnsureCursorVisible();
 	int GetPageSize() const;
 	std::string GetText(const Coordinates& aStart, const Coordinates& aEnd) const;
@@ -325,7 +458,7 @@ private:
 	void DeleteRange(const Coordinates& aStart, const Coordinates& aEnd);
 	int InsertTextAt(Coordinates& aWhere, const char* aValue);
 	void AddUndo(UndoRecord& aValue);
-	Coordinates ScreenPosToCoordinates(const ImVec2& aPosition) const;
+	Coordinates ScreenPosToCoordinates(const ImVec2& aPosition);
 	Coordinates FindWordStart(const Coordinates& aFrom) const;
 	Coordinates FindWordEnd(const Coordinates& aFrom) const;
 	Coordinates FindNextWord(const Coordinates& aFrom) const;
@@ -338,11 +471,10 @@ private:
 	void RemoveLine(int aIndex);
 	Line& InsertLine(int aIndex);
 	void EnterCharacter(ImWchar aChar, bool aShift);
-	void Backspace();
 	void DeleteSelection();
 	std::string GetWordUnderCursor() const;
 	std::string GetWordAt(const Coordinates& aCoords) const;
-	ImU32 GetGlyphColor(const Glyph& aGlyph) const;
+	ImU32 GetGlyphColor(PaletteIndex aColorIndex, uint8_t aFlags) const;
 
 	void HandleKeyboardInputs();
 	void HandleMouseInputs();
@@ -376,13 +508,23 @@ private:
 	Palette mPalette;
 	LanguageDefinition mLanguageDefinition;
 	RegexList mRegexList;
+	WordTable mWordTable;
 
 	bool mCheckComments;
+	int mCommentRangeMin, mCommentRangeMax;	// edited lines since the last comment scan
+	std::vector<LineState> mLineStates;		// parallel to mLines
 	Breakpoints mBreakpoints;
 	ErrorMarkers mErrorMarkers;
 	ImVec2 mCharAdvance;
 	Coordinates mInteractiveStart, mInteractiveEnd;
-	std::string mLineBuffer;
+	std::vector<LineLayout> mLineLayouts;	// slot per line number modulo the size, a power of two
+	uint32_t mLayoutGeneration;				// bumped when every layout goes stale
+
+	// Glyph advances of the current font at the current size
+	ImFont* mAdvanceFont;
+	float mAdvanceFontSize;
+	std::array<float, 128> mAsciiAdvances;
+	std::unordered_map<uint32_t, float> mGlyphAdvances;	// other glyphs by their UTF-8 bytes
 	uint64_t mStartTime;
 
 	float mLastClick;
@@ -0,0 +1,241 @@
+#include "file_watcher.h"
+#include <SDL3/SDL.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+#ifdef __linux__
+#include <errno.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+static const int kDebounceMs = 100;
+static const int kMaxDelayMs = 1000;        // a file that never goes quiet is still reported
+static const int kPollIntervalMs = 250;    // polling fallback only
+
+static std::mutex watchMutex;
+static std::set<std::string> watched;
+static std::set<std::string> settled;      // waiting for TakeChangedFiles
+static std::thread watcherThread;
+static std::atomic<bool> watcherQuit{false};
+static Uint32 wakeEvent = 0;
+
+static std::string DirectoryOf(const std::string& path){
+    size_t slash = path.find_last_of("/\\");
+    return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+}
+
+static void Publish(std::set<std::string>* pending){
+    {
+        std::lock_guard<std::mutex> lock(watchMutex);
+        settled.insert(pending->begin(), pending->end());
+    }
+    pending->clear();
+    // any event wakes SDL_AppIterate, which then takes the changes
+    SDL_Event event;
+    SDL_zero(event);
+    event.type = wakeEvent;
+    SDL_PushEvent(&event);
+}
+
+#ifdef __linux__
+static int inotifyFd = -1;
+static int stopFd = -1;
+static std::map<int, std::string> watchDirs;   // watch descriptor -> directory prefix
+
+// Only events on watched files move the debounce deadline; other files in
+// the same directories (build output, editor swap files) can't hold it back.
+static void WatcherMain(){
+    std::set<std::string> pending;
+    Uint64 firstChange = 0;     // of the pending set
+    Uint64 lastChange = 0;
+    alignas(inotify_event) char buffer[4096];
+    while (!watcherQuit) {
+        int timeout = -1;
+        if (!pending.empty()) {
+            Uint64 now = SDL_GetTicks();
+            Uint64 due = SDL_min(lastChange + kDebounceMs, firstChange + kMaxDelayMs);
+            if (now >= due) {
+                Publish(&pending);
+                continue;
+            }
+            timeout = (int)(due - now);
+        }
+        pollfd fds[2] = { { inotifyFd, POLLIN, 0 }, { stopFd, POLLIN, 0 } };
+        int ready = poll(fds, 2, timeout);
+        if (ready < 0 && errno != EINTR) {
+            SDL_Log("File watcher stopped: poll failed (%d)", errno);
+            break;
+        }
+        if (fds[1].revents & POLLIN) {
+            break;
+        }
+        if (ready <= 0 || !(fds[0].revents & POLLIN)) {
+            continue;
+        }
+        ssize_t length = read(inotifyFd, buffer, sizeof(buffer));
+        std::lock_guard<std::mutex> lock(watchMutex);
+        for (ssize_t offset = 0; offset < length;) {
+            const inotify_event* event = (const inotify_event*)(buffer + offset);
+            offset += sizeof(inotify_event) + event->len;
+            auto dir = watchDirs.find(event->wd);
+            if (event->len == 0 || dir == watchDirs.end()) {
+                continue;
+            }
+            std::string path = dir->second + event->name;
+            if (watched.count(path)) {
+                lastChange = SDL_GetTicks();
+                if (pending.empty()) {
+                    firstChange = lastChange;
+                }
+                pending.insert(path);
+            }
+        }
+    }
+}
+
+bool InitFileWatcher(){
+    wakeEvent = SDL_RegisterEvents(1);
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    stopFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (inotifyFd < 0 || stopFd < 0) {
+        SDL_Log("inotify unavailable (%d), shader files are not watched", errno);
+        ShutdownFileWatcher();
+        return false;
+    }
+    watcherQuit = false;
+    watcherThread = std::thread(WatcherMain);
+    return true;
+}
+
+void ShutdownFileWatcher(){
+    watcherQuit = true;
+    if (watcherThread.joinable()) {
+        uint64_t one = 1;
+        ssize_t written = write(stopFd, &one, sizeof(one));
+        (void)written;
+        watcherThread.join();
+    }
+    if (inotifyFd >= 0) {
+        close(inotifyFd);
+    }
+    if (stopFd >= 0) {
+        close(stopFd);
+    }
+    inotifyFd = -1;
+    stopFd = -1;
+    watchDirs.clear();
+    watched.clear();
+    settled.clear();
+}
+
+void WatchFiles(const std::vector<std::string>& paths){
+    if (inotifyFd < 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(watchMutex);
+    watched = std::set<std::string>(paths.begin(), paths.end());
+    // directories, not files: a save that renames over the file would drop a file watch
+    std::set<std::string> dirs;
+    for (const std::string& path : watched) {
+        dirs.insert(DirectoryOf(path));
+    }
+    for (auto it = watchDirs.begin(); it != watchDirs.end();) {
+        if (dirs.erase(it->second) == 0) {
+            inotify_rm_watch(inotifyFd, it->first);
+            it = watchDirs.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    for (const std::string& dir : dirs) {
+        int wd = inotify_add_watch(inotifyFd, dir.empty() ? "." : dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+        if (wd < 0) {
+            SDL_Log("Couldn't watch '%s' (%d)", dir.c_str(), errno);
+            continue;
+        }
+        watchDirs[wd] = dir;
+    }
+}
+
+#else
+static std::mutex quitMutex;
+static std::condition_variable quitWake;
+
+static Sint64 ModifyTime(const std::string& path){
+    SDL_PathInfo info;
+    return SDL_GetPathInfo(path.c_str(), &info) ? (Sint64)info.modify_time : 0;
+}
+
+// Reports a file once its time stopped changing for one poll interval.
+static void WatcherMain(){
+    std::map<std::string, Sint64> times;
+    std::set<std::string> pending;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(quitMutex);
+            if (quitWake.wait_for(lock, std::chrono::milliseconds(kPollIntervalMs), []{ return watcherQuit.load(); })) {
+                return;
+            }
+        }
+        std::set<std::string> files;
+        {
+            std::lock_guard<std::mutex> lock(watchMutex);
+            files = watched;
+        }
+        bool changed = false;
+        std::map<std::string, Sint64> current;
+        for (const std::string& path : files) {
+            Sint64 time = ModifyTime(path);
+            auto previous = times.find(path);
+            if (previous != times.end() && previous->second != time) {
+                pending.insert(path);
+                changed = true;
+            }
+            current[path] = time;
+        }
+        times.swap(current);
+        if (!changed && !pending.empty()) {
+            Publish(&pending);
+        }
+    }
+}
+
+bool InitFileWatcher(){
+    wakeEvent = SDL_RegisterEvents(1);
+    watcherQuit = false;
+    watcherThread = std::thread(WatcherMain);
+    return true;
+}
+
+void ShutdownFileWatcher(){
+    {
+        std::lock_guard<std::mutex> lock(quitMutex);
+        watcherQuit = true;
+    }
+    quitWake.notify_all();
+    if (watcherThread.joinable()) {
+        watcherThread.join();
+    }
+    watched.clear();
+    settled.clear();
+}
+
+void WatchFiles(const std::vector<std::string>& paths){
+    std::lock_guard<std::mutex> lock(watchMutex);
+    watched = std::set<std::string>(paths.begin(), paths.end());
+}
+#endif
+
+std::vector<std::string> TakeChangedFiles(){
+    std::lock_guard<std::mutex> lock(watchMutex);
+    std::vector<std::string> files(settled.begin(), settled.end());
+    settled.clear();
+    return files;
+}
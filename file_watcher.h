@@ -0,0 +1,18 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// Watches a set of files and reports each change once the file has been
+// quiet for a short debounce interval (editors often save in several writes).
+// Linux uses inotify on the containing directories, which also catches
+// editors that save by renaming over the file; elsewhere modification times
+// are polled. A background thread waits for changes and pushes an SDL event,
+// so changes are picked up while the main loop sleeps for events.
+bool InitFileWatcher();
+void ShutdownFileWatcher();
+
+// Replaces the watched set.
+void WatchFiles(const std::vector<std::string>& paths);
+
+// Settled changes since the last call, as passed to WatchFiles. Call once per frame.
+std::vector<std::string> TakeChangedFiles();
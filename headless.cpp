@@ -0,0 +1,397 @@
+#include "headless.h"
+#include "renderer.h"
+#include "shader_preprocessor.h"
+#include <SDL3/SDL.h>
+#ifdef HAVE_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <sstream>
+#include <vector>
+
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+
+struct HeadlessContext {
+#ifdef HAVE_EGL
+    EGLDisplay display = EGL_NO_DISPLAY;
+    EGLContext context = EGL_NO_CONTEXT;
+#endif
+    SDL_Window* window = NULL;
+    SDL_GLContext glContext = NULL;
+};
+
+// Context creation ////
+#ifdef HAVE_EGL
+// eglInitialize on an initialized display hands back the same one, so it is
+// only terminated together with the last context on it.
+static int eglContextCount = 0;
+
+static void ReleaseUnusedDisplay(EGLDisplay display){
+    if (eglContextCount == 0) {
+        eglTerminate(display);
+    }
+}
+
+static bool CreateEGLContext(HeadlessContext* ctx){
+    EGLDisplay display = EGL_NO_DISPLAY;
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (getPlatformDisplay) {
+        display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    }
+    if (display == EGL_NO_DISPLAY) {
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL)) {
+        SDL_Log("EGL: no display available (0x%x)", eglGetError());
+        return false;
+    }
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+        SDL_Log("EGL: desktop OpenGL is not supported (0x%x)", eglGetError());
+        ReleaseUnusedDisplay(display);
+        return false;
+    }
+
+    const EGLint configAttribs[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8,
+        EGL_GREEN_SIZE, 8,
+        EGL_BLUE_SIZE, 8,
+        EGL_ALPHA_SIZE, 8,
+        EGL_NONE
+    };
+    EGLConfig config;
+    EGLint numConfigs = 0;
+    if (!eglChooseConfig(display, configAttribs, &config, 1, &numConfigs) || numConfigs == 0) {
+        SDL_Log("EGL: no suitable config (0x%x)", eglGetError());
+        ReleaseUnusedDisplay(display);
+        return false;
+    }
+
+    const EGLint contextAttribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs);
+    if (context == EGL_NO_CONTEXT) {
+        SDL_Log("EGL: couldn't create GL 3.3 context (0x%x)", eglGetError());
+        ReleaseUnusedDisplay(display);
+        return false;
+    }
+    // surfaceless: everything is drawn into FBOs
+    if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+        SDL_Log("EGL: surfaceless make current failed (0x%x)", eglGetError());
+        eglDestroyContext(display, context);
+        ReleaseUnusedDisplay(display);
+        return false;
+    }
+    if (!gladLoadGL((GLADloadfunc)eglGetProcAddress)) {
+        SDL_Log("EGL: couldn't load GL functions");
+        eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroyContext(display, context);
+        ReleaseUnusedDisplay(display);
+        return false;
+    }
+    ctx->display = display;
+    ctx->context = context;
+    eglContextCount++;
+    return true;
+}
+#endif
+
+static bool CreateHiddenWindowContext(HeadlessContext* ctx){
+    if (!SDL_InitSubSystem(SDL_INIT_VIDEO)) {
+        SDL_Log("Couldn't initialize video: %s", SDL_GetError());
+        return false;
+    }
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+    ctx->window = SDL_CreateWindow("SDL3 Shader (headless)", 16, 16, SDL_WINDOW_OPENGL|SDL_WINDOW_HIDDEN);
+    if (!ctx->window) {
+        SDL_Log("Couldn't create hidden window : %s", SDL_GetError());
+        return false;
+    }
+    ctx->glContext = SDL_GL_CreateContext(ctx->window);
+    if (ctx->glContext == NULL) {
+        SDL_Log("Couldn't create gl context: %s", SDL_GetError());
+        return false;
+    }
+    SDL_GL_MakeCurrent(ctx->window, ctx->glContext);
+    return gladLoadGL((GLADloadfunc) SDL_GL_GetProcAddress) != 0;
+}
+
+HeadlessContext* CreateHeadlessContext(){
+    HeadlessContext* ctx = new HeadlessContext();
+#ifdef HAVE_EGL
+    if (CreateEGLContext(ctx)) {
+        return ctx;
+    }
+    SDL_Log("EGL unavailable, falling back to a hidden window");
+#endif
+    if (CreateHiddenWindowContext(ctx)) {
+        return ctx;
+    }
+    DestroyHeadlessContext(ctx);
+    return NULL;
+}
+
+bool MakeHeadlessContextCurrent(HeadlessContext* ctx){
+#ifdef HAVE_EGL
+    if (ctx->context != EGL_NO_CONTEXT) {
+        return eglMakeCurrent(ctx->display, EGL_NO_SURFACE, EGL_NO_SURFACE, ctx->context);
+    }
+#endif
+    return SDL_GL_MakeCurrent(ctx->window, ctx->glContext);
+}
+
+void ReleaseHeadlessContext(HeadlessContext* ctx){
+#ifdef HAVE_EGL
+    if (ctx->context != EGL_NO_CONTEXT) {
+        eglMakeCurrent(ctx->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        return;
+    }
+#endif
+    SDL_GL_MakeCurrent(ctx->window, NULL);
+}
+
+void DestroyHeadlessContext(HeadlessContext* ctx){
+    if (!ctx) {
+        return;
+    }
+#ifdef HAVE_EGL
+    if (ctx->context != EGL_NO_CONTEXT) {
+        eglMakeCurrent(ctx->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroyContext(ctx->display, ctx->context);
+        if (--eglContextCount == 0) {
+            eglTerminate(ctx->display);
+        }
+    }
+#endif
+    if (ctx->glContext) {
+        SDL_GL_DestroyContext(ctx->glContext);
+    }
+    if (ctx->window) {
+        SDL_DestroyWindow(ctx->window);
+    }
+    delete ctx;
+}
+
+// Headless benchmark ////
+bool ParseBenchArgs(int argc, char* argv[], BenchOptions* opts){
+    bool bench = false;
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* next = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (SDL_strcmp(arg, "--bench") == 0 && next) {
+            bench = true;
+            opts->shaderPath = next; i++;
+        } else if (SDL_strcmp(arg, "--size") == 0 && next) {
+            SDL_sscanf(next, "%dx%d", &opts->width, &opts->height); i++;
+        } else if (SDL_strcmp(arg, "--frames") == 0 && next) {
+            opts->frames = SDL_atoi(next); i++;
+        } else if (SDL_strcmp(arg, "--warmup") == 0 && next) {
+            opts->warmup = SDL_atoi(next); i++;
+        } else if (SDL_strcmp(arg, "--dt") == 0 && next) {
+            opts->timeStep = (float)SDL_atof(next); i++;
+        } else if (SDL_strcmp(arg, "--json") == 0 && next) {
+            opts->jsonPath = next; i++;
+        }
+    }
+    return bench;
+}
+
+struct TimingStats {
+    double min = 0.0;
+    double median = 0.0;
+    double p99 = 0.0;
+    double mean = 0.0;
+};
+
+static TimingStats ComputeStats(std::vector<double> samples){
+    TimingStats stats;
+    if (samples.empty()) {
+        return stats;
+    }
+    std::sort(samples.begin(), samples.end());
+    size_t n = samples.size();
+    double sum = 0.0;
+    for (double s : samples) {
+        sum += s;
+    }
+    size_t p99Index = (size_t)std::ceil(0.99 * (double)n);
+    stats.min = samples[0];
+    stats.median = (n % 2) ? samples[n / 2] : 0.5 * (samples[n / 2 - 1] + samples[n / 2]);
+    stats.p99 = samples[std::min(n - 1, p99Index > 0 ? p99Index - 1 : 0)];
+    stats.mean = sum / (double)n;
+    return stats;
+}
+
+static std::string EscapeJson(const char* s){
+    std::string out;
+    for (; s && *s; s++) {
+        char c = *s;
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if ((unsigned char)c < 0x20) {
+            char buf[8];
+            SDL_snprintf(buf, sizeof(buf), "\\u%04x", c);
+            out += buf;
+        } else {
+            out += c;
+        }
+    }
+    return out;
+}
+
+static void WriteStats(std::ostringstream& json, const char* name, const TimingStats& stats, bool last){
+    json << "  \"" << name << "\": {\"min\": " << stats.min
+         << ", \"median\": " << stats.median
+         << ", \"p99\": " << stats.p99
+         << ", \"mean\": " << stats.mean << "}" << (last ? "\n" : ",\n");
+}
+
+bool RunBenchmark(const BenchOptions& opts, const std::string& vertexSource){
+    if (opts.shaderPath.empty() || opts.width <= 0 || opts.height <= 0 || opts.frames <= 0 || opts.warmup < 0 || !(opts.timeStep > 0.0f)) {
+        SDL_Log("usage: main --bench <shader.glsl> [--size WxH] [--frames N] [--warmup N] [--dt seconds] [--json path]");
+        return false;
+    }
+    std::string fragmentSource, error;
+    SourceMap sourceMap;
+    if (!ExpandShader(opts.shaderPath, &fragmentSource, &sourceMap, &error)) {
+        SDL_Log("%s", error.c_str());
+        return false;
+    }
+
+    HeadlessContext* ctx = CreateHeadlessContext();
+    if (!ctx) {
+        return false;
+    }
+
+    std::string log;
+    GLuint program = CompileProgram(vertexSource, fragmentSource, &log);
+    if (program == 0) {
+        SDL_Log("%s", MapShaderLog(log, sourceMap).c_str());
+        DestroyHeadlessContext(ctx);
+        return false;
+    }
+
+    ProgramReflection reflection;
+    ReflectProgram(program, &reflection);
+    ShaderQuad quad;
+    CreateFullscreenQuad(&quad);
+
+    GLuint fbo, colorBuffer;
+    glGenRenderbuffers(1, &colorBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, opts.width, opts.height);
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        SDL_Log("Offscreen framebuffer %dx%d is incomplete", opts.width, opts.height);
+        glDeleteFramebuffers(1, &fbo);
+        glDeleteRenderbuffers(1, &colorBuffer);
+        DestroyFullscreenQuad(&quad);
+        glDeleteProgram(program);
+        DestroyHeadlessContext(ctx);
+        return false;
+    }
+
+    glViewport(0, 0, opts.width, opts.height);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    // one query per measured frame, read back after the run so nothing stalls
+    std::vector<GLuint> queries(opts.frames);
+    glGenQueries(opts.frames, queries.data());
+    std::vector<double> cpuMs, wallMs, gpuMs;
+    cpuMs.reserve(opts.frames);
+    wallMs.reserve(opts.frames);
+    gpuMs.reserve(opts.frames);
+
+    const double toMs = 1000.0 / (double)SDL_GetPerformanceFrequency();
+    ShaderInputs in;
+    in.width = (float)opts.width;
+    in.height = (float)opts.height;
+    in.mouseX = in.width * 0.5f;
+    in.mouseY = in.height * 0.5f;
+
+    int total = opts.warmup + opts.frames;
+    for (int i = 0; i < total; i++) {
+        int measured = i - opts.warmup;
+        in.time = (float)i * opts.timeStep;
+        in.timeDelta = opts.timeStep;
+        in.frameRate = 1.0f / opts.timeStep;
+        in.frame = i;
+        in.date[3] = in.time;
+
+        Uint64 start = SDL_GetPerformanceCounter();
+        if (measured >= 0) {
+            glBeginQuery(GL_TIME_ELAPSED, queries[measured]);
+        }
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+        DrawShaderQuad(program, reflection, quad, in);
+        if (measured >= 0) {
+            glEndQuery(GL_TIME_ELAPSED);
+        }
+        Uint64 submitted = SDL_GetPerformanceCounter();
+        glFinish();
+        Uint64 finished = SDL_GetPerformanceCounter();
+
+        if (measured >= 0) {
+            cpuMs.push_back((double)(submitted - start) * toMs);
+            wallMs.push_back((double)(finished - start) * toMs);
+        }
+    }
+    for (int i = 0; i < opts.frames; i++) {
+        GLuint64 ns = 0;
+        glGetQueryObjectui64v(queries[i], GL_QUERY_RESULT, &ns);
+        gpuMs.push_back((double)ns / 1.0e6);
+    }
+
+    std::ostringstream json;
+    json << "{\n";
+    json << "  \"shader\": \"" << EscapeJson(opts.shaderPath.c_str()) << "\",\n";
+    json << "  \"gl_vendor\": \"" << EscapeJson((const char*)glGetString(GL_VENDOR)) << "\",\n";
+    json << "  \"gl_renderer\": \"" << EscapeJson((const char*)glGetString(GL_RENDERER)) << "\",\n";
+    json << "  \"gl_version\": \"" << EscapeJson((const char*)glGetString(GL_VERSION)) << "\",\n";
+    json << "  \"width\": " << opts.width << ",\n";
+    json << "  \"height\": " << opts.height << ",\n";
+    json << "  \"frames\": " << opts.frames << ",\n";
+    json << "  \"warmup\": " << opts.warmup << ",\n";
+    json << "  \"time_step\": " << opts.timeStep << ",\n";
+    WriteStats(json, "cpu_submit_ms", ComputeStats(cpuMs), false);
+    WriteStats(json, "cpu_frame_ms", ComputeStats(wallMs), false);
+    WriteStats(json, "gpu_ms", ComputeStats(gpuMs), true);
+    json << "}\n";
+
+    bool ok = true;
+    std::string result = json.str();
+    if (opts.jsonPath.empty()) {
+        fputs(result.c_str(), stdout);
+        fflush(stdout);
+    } else if (!SDL_SaveFile(opts.jsonPath.c_str(), result.data(), result.size())) {
+        SDL_Log("Failed to save file: %s", SDL_GetError());
+        ok = false;
+    }
+
+    glDeleteQueries(opts.frames, queries.data());
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &fbo);
+    glDeleteRenderbuffers(1, &colorBuffer);
+    DestroyFullscreenQuad(&quad);
+    glDeleteProgram(program);
+    DestroyHeadlessContext(ctx);
+    return ok;
+}
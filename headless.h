@@ -0,0 +1,30 @@
+#pragma once
+#include <string>
+
+// Offscreen GL 3.3 context that never touches SDL_CreateWindow when EGL is
+// available (surfaceless Mesa, llvmpipe included). Without EGL it falls back
+// to a hidden SDL window, which still needs a display.
+// Several contexts can live side by side, one per thread; create and destroy
+// them on one thread and hand them over with Release/MakeCurrent.
+struct HeadlessContext;
+
+HeadlessContext* CreateHeadlessContext();
+bool MakeHeadlessContextCurrent(HeadlessContext* ctx);
+// Detaches the context from the calling thread so another one can make it current.
+void ReleaseHeadlessContext(HeadlessContext* ctx);
+void DestroyHeadlessContext(HeadlessContext* ctx);
+
+// Headless benchmark ////
+struct BenchOptions {
+    std::string shaderPath;
+    std::string jsonPath;   // empty = stdout
+    int width = 1920;
+    int height = 1080;
+    int frames = 300;
+    int warmup = 10;
+    float timeStep = 1.0f / 60.0f;
+};
+
+// Returns true when argv asks for the benchmark (`--bench <shader.glsl>`).
+bool ParseBenchArgs(int argc, char* argv[], BenchOptions* opts);
+bool RunBenchmark(const BenchOptions& opts, const std::string& vertexSource);
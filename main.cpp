@@ -6,17 +6,49 @@
 #include <SDL3/SDL.h>
 #include <SDL3/SDL_main.h>
 #include <SDL3/SDL_dialog.h>
+#include "renderer.h"
+#include "headless.h"
+#include "export.h"
+#include "batch.h"
+#include "shader_compiler.h"
+#include "program_cache.h"
+#include "render_scale.h"
+#include "multipass.h"
+#include "texture_loader.h"
+#include "shader_preprocessor.h"
+#include "file_watcher.h"
+#include "profiler.h"
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <math.h>
+#include <memory>
+#include <mutex>
+#include <set>
 
 static SDL_Window *window = NULL;
 static SDL_GLContext gl_context = NULL;
 static GLuint shaderProgram;
-static GLuint VAO, VBO;
+static ProgramReflection shaderUniforms;
+static ShaderQuad quad;
+static Multipass multipass;
+static float lastFrameTime = 0.0f;
+static int frameCount = 0;
+
+// frame pacing
+static RenderScale renderScale;
+static bool windowOccluded = false;
+static int redrawFrames = 0;            // frames still owed after input, ImGui needs a few to settle
+static std::string activeRate = "60";   // display refresh rate
+static std::string currentRate;
+static const int REDRAW_FRAMES_AFTER_EVENT = 3;
 static bool pendingShaderReload = false;
+static const Uint64 PROGRAM_CACHE_MAX_BYTES = 64ull * 1024 * 1024;
 static bool show_metrics = false;
+static bool show_profiler = false;
+static bool show_shader_log = false;
+static std::string shaderLog;
+static std::string projectPath;     // .passes file behind the current project, empty for single shaders
 
 float clickX, clickY;
 bool isLeftDown = false;
@@ -34,7 +66,8 @@ void main(){
 }
 )";
 
-// default Fragment Shader is also current shader
+// default Fragment Shader is also current shader (#includes expanded); Save
+// writes the image pass file as on disk instead
 static std::string defaultFragmentShader = R"(
 #version 330 core
 
@@ -48,66 +81,149 @@ void main(){
 } 
 )";
 
-// OpenGL Helpers ////
-void CheckShaderCompilation(GLuint shader, const char* type) {
-    GLint success;
-    GLchar infoLog[1024];
-    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        glGetShaderInfoLog(shader, 1024, NULL, infoLog);
-        std::cerr << "Shader Compilation Error (" << type << "): " << infoLog << std::endl;
+GLuint LoadDefaultShader(){
+    Uint64 cacheKey = ProgramCacheKey(defaultVertexShader, defaultFragmentShader);
+    GLuint program = LoadCachedProgram(cacheKey);
+    if (program == 0) {
+        program = CompileProgram(defaultVertexShader, defaultFragmentShader);
+        StoreCachedProgram(cacheKey, program);
     }
+    return program;
 }
 
-void CheckShaderLinking(GLuint program) {
-    GLint success;
-    GLchar infoLog[1024];
-    glGetProgramiv(program, GL_LINK_STATUS, &success);
-    if (!success) {
-        glGetProgramInfoLog(program, 1024, NULL, infoLog);
-        std::cerr << "Shader Linking Error: " << infoLog << std::endl;
+// File Saving & Loading ////
+static const SDL_DialogFileFilter file_filters[] = {
+    { "glsl shader",  "glsl" },
+    { "shader project", "passes" },
+    { "All files",   "*" }
+};
+static const SDL_DialogFileFilter texture_filters[] = {
+    { "image", "png;jpg;jpeg;dds" },
+    { "All files",   "*" }
+};
+static const SDL_DialogFileFilter trace_filters[] = {
+    { "chrome trace", "json" },
+    { "All files",   "*" }
+};
+
+// Dialog callbacks may run off the main thread; loading touches GL, so the
+// path is handed over and loaded at the start of the next frame.
+static std::mutex loadMutex;
+static std::string pendingLoadPath;
+static int pendingLoadChannel = -1;
+static Uint32 loadWakeEvent = 0;   // wakes SDL_AppIterate in waitevent mode
+
+// `channel` >= 0 loads the file as a texture into that iChannel.
+static void RequestLoad(const char* path, int channel = -1){
+    {
+        std::lock_guard<std::mutex> lock(loadMutex);
+        pendingLoadPath = path;
+        pendingLoadChannel = channel;
+    }
+    if (loadWakeEvent != 0) {
+        SDL_Event event;
+        SDL_zero(event);
+        event.type = loadWakeEvent;
+        SDL_PushEvent(&event);
     }
 }
 
-GLuint LoadDefaultShader(){
-    const char* vsrc = defaultVertexShader.c_str(); 
-    const char* fsrc = defaultFragmentShader.c_str();
-    GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader,1,&vsrc,NULL);
-    glCompileShader(vertexShader);
-    CheckShaderCompilation(vertexShader,"VERTEX");
-
-    GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader,1,&fsrc,NULL);
-    glCompileShader(fragmentShader);
-    CheckShaderCompilation(fragmentShader,"FRAGMENT");
-
-    GLuint tempShaderProgram = glCreateProgram();
-    glAttachShader(tempShaderProgram,vertexShader);
-    glAttachShader(tempShaderProgram, fragmentShader);
-    glLinkProgram(tempShaderProgram);
-    CheckShaderLinking(tempShaderProgram);
-
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
-
-    return tempShaderProgram;
+static bool IsProjectFile(const std::string& path){
+    const std::string ext = ".passes";
+    return path.size() >= ext.size() && path.compare(path.size() - ext.size(), ext.size(), ext) == 0;
 }
 
-void CheckGLError(const char* function) {
-    GLenum err;
-    while ((err = glGetError()) != GL_NO_ERROR) {
-        std::cerr << "OpenGL Error in " << function << ": " << err << std::endl;
+// Watches every file the current shader or project is built from.
+static void UpdateWatchedFiles(){
+    std::vector<std::string> files;
+    if (!projectPath.empty()) {
+        files.push_back(projectPath);
+    }
+    for (int p = 0; p < Pass_COUNT; p++) {
+        const PassDesc& pass = multipass.manifest.passes[p];
+        if (!pass.sourcePath.empty()) {
+            std::vector<std::string> deps = ShaderDependencies(pass.sourcePath);
+            files.insert(files.end(), deps.begin(), deps.end());
+        }
     }
+    WatchFiles(files);
 }
 
-// File Saving & Loading ////
-static const SDL_DialogFileFilter file_filters[] = {
-    { "glsl shader",  "glsl" },
-    { "All files",   "*" }
-};
+static void ShowShaderError(const std::string& error){
+    SDL_Log("%s", error.c_str());
+    shaderLog = error;
+    show_shader_log = true;
+}
 
+// Expands the image pass from its file and queues the compile.
+static void ReloadImagePass(){
+    std::string error;
+    if (!ReloadPassSource(&multipass, Pass_Image, defaultVertexShader, &error)) {
+        ShowShaderError(error);
+        return;
+    }
+    defaultFragmentShader = multipass.manifest.passes[Pass_Image].source;
+    pendingShaderReload = true;
+}
+
+// Loads a single fragment shader, a multipass project manifest, or an image
+// into an iChannel of the image pass (iChannel0 when dropped).
+static void LoadShaderOrProject(const std::string& path, int channel){
+    if (channel >= 0 || IsTextureFile(path)) {
+        SetPassChannelTexture(&multipass, Pass_Image, channel >= 0 ? channel : 0, path);
+        return;
+    }
+    ClearShaderCache(); // an explicit load always reads from disk
+    if (IsProjectFile(path)) {
+        ProjectManifest manifest;
+        if (!LoadProjectManifest(path.c_str(), &manifest)) {
+            return;
+        }
+        projectPath = NormalizeShaderPath(path);
+        defaultFragmentShader = manifest.passes[Pass_Image].source;
+        SetMultipassProject(&multipass, manifest, defaultVertexShader);
+        pendingShaderReload = true;
+    } else {
+        ClearMultipass(&multipass);
+        projectPath.clear();
+        PassDesc& image = multipass.manifest.passes[Pass_Image];
+        image.enabled = true;
+        image.sourcePath = NormalizeShaderPath(path);
+        ReloadImagePass();
+    }
+    UpdateWatchedFiles();
+}
+
+// Re-expands and recompiles only the passes built from a changed file.
+static void ReloadChangedFiles(const std::vector<std::string>& files){
+    std::set<std::string> affected;
+    for (const std::string& file : files) {
+        std::vector<std::string> invalidated = InvalidateShaderFile(file);
+        affected.insert(invalidated.begin(), invalidated.end());
+    }
+    if (!projectPath.empty() && affected.count(projectPath)) {
+        LoadShaderOrProject(projectPath, -1);
+        return;
+    }
+    for (int p = 0; p < Pass_COUNT; p++) {
+        const PassDesc& pass = multipass.manifest.passes[p];
+        if (pass.sourcePath.empty() || !affected.count(pass.sourcePath)) {
+            continue;
+        }
+        std::string error;
+        if (p == Pass_Image) {
+            ReloadImagePass();
+        } else if (!ReloadPassSource(&multipass, (PassId)p, defaultVertexShader, &error)) {
+            ShowShaderError(error);
+        }
+    }
+    UpdateWatchedFiles(); // includes may have been added or removed
+}
+
+// `userdata` is a copy of the text taken when the dialog opened, since the
+// callback may run on another thread while the shader reloads.
 static void SDLCALL save_callback(void* userdata, const char* const* filelist, int filter){
+    std::unique_ptr<std::string> text((std::string*)userdata);
     if (!filelist) {
         SDL_Log("An error occured: %s", SDL_GetError());
         return;
@@ -117,8 +233,7 @@ static void SDLCALL save_callback(void* userdata, const char* const* filelist, i
     }
 
     const char* save_path = filelist[0];
-    size_t data_size = SDL_strlen(defaultFragmentShader.c_str()) + 1;
-    if (SDL_SaveFile(save_path, defaultFragmentShader.c_str(), data_size)) {
+    if (SDL_SaveFile(save_path, text->c_str(), text->size())) {
         SDL_Log("Successfully saved file: '%s'", save_path);
     } else {
         SDL_Log("Failed to save file: %s", SDL_GetError());
@@ -147,15 +262,7 @@ static void SDLCALL load_callback(void* userdata, const char* const* filelist, i
     }
 
     const char* load_path = filelist[0];
-    size_t fileSize = 0;
-    void* fileData = SDL_LoadFile(load_path, &fileSize);
-    if (fileData == NULL) {
-        SDL_Log("Error loading file: ",SDL_GetError()); 
-        return;
-    }
-    defaultFragmentShader = std::string((char*)fileData, fileSize);
-    SDL_free(fileData);
-    pendingShaderReload = true;
+    RequestLoad(load_path);
     if (filter < 0) {
         SDL_Log("The current platform does not support fetching "
                 "the selected filter, or the user did not select"
@@ -168,11 +275,63 @@ static void SDLCALL load_callback(void* userdata, const char* const* filelist, i
     }
 }
 
+static void SDLCALL trace_save_callback(void* userdata, const char* const* filelist, int filter){
+    if (!filelist) {
+        SDL_Log("An error occured: %s", SDL_GetError());
+        return;
+    } else if (!*filelist) {
+        SDL_Log("The dialog was canceled.");
+        return;
+    }
+    ExportChromeTrace(filelist[0]); // reads the frame ring, safe off the main thread
+}
+
+static void SDLCALL channel_load_callback(void* userdata, const char* const* filelist, int filter){
+    if (!filelist) {
+        SDL_Log("An error occured: %s", SDL_GetError());
+        return;
+    } else if (!*filelist) {
+        SDL_Log("The dialog was canceled.");
+        return;
+    }
+    RequestLoad(filelist[0], (int)(intptr_t)userdata);
+}
+
+static std::string ChannelLabel(const ChannelInput& channel){
+    if (channel.kind == Channel_Buffer) {
+        return std::string("Buffer ") + (char)('A' + channel.buffer);
+    }
+    if (channel.kind == Channel_Texture) {
+        size_t slash = channel.texturePath.find_last_of("/\\");
+        std::string name = slash == std::string::npos ? channel.texturePath : channel.texturePath.substr(slash + 1);
+        TextureInfo info;
+        if (GetTexture(channel.texture, &info)) {
+            return name;
+        }
+        return name + (IsTextureFailed(channel.texture) ? " (failed)" : " (loading)");
+    }
+    return "none";
+}
 
 /* init */
 SDL_AppResult SDL_AppInit(void **appstate, int argc, char *argv[]){
+    BenchOptions bench;
+    if (ParseBenchArgs(argc, argv, &bench)) {
+        return RunBenchmark(bench, defaultVertexShader) ? SDL_APP_SUCCESS : SDL_APP_FAILURE;
+    }
+    ExportOptions exportOpts;
+    if (ParseExportArgs(argc, argv, &exportOpts)) {
+        return RunExport(exportOpts, defaultVertexShader) ? SDL_APP_SUCCESS : SDL_APP_FAILURE;
+    }
+    BatchOptions batchOpts;
+    if (ParseBatchArgs(argc, argv, &batchOpts)) {
+        return RunBatch(batchOpts, defaultVertexShader) ? SDL_APP_SUCCESS : SDL_APP_FAILURE;
+    }
 	
 	SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
+#ifdef SHADER_GL_DEBUG
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, SDL_GL_CONTEXT_DEBUG_FLAG);
+#endif
 	
     /* Create the window */
 	window = SDL_CreateWindow("SDL3 Shader", 600, 600, SDL_WINDOW_TRANSPARENT|SDL_WINDOW_ALWAYS_ON_TOP|SDL_WINDOW_RESIZABLE|SDL_WINDOW_OPENGL); 
@@ -180,7 +339,10 @@ SDL_AppResult SDL_AppInit(void **appstate, int argc, char *argv[]){
         SDL_Log("Couldn't create window : %s", SDL_GetError());
         return SDL_APP_FAILURE;
     }
-	SDL_SetHint(SDL_HINT_MAIN_CALLBACK_RATE, "60");
+	const SDL_DisplayMode* mode = SDL_GetCurrentDisplayMode(SDL_GetDisplayForWindow(window));
+	if (mode && mode->refresh_rate > 0.0f) {
+		activeRate = std::to_string((int)(mode->refresh_rate + 0.5f));
+	}
 	// create gl context
 	gl_context = SDL_GL_CreateContext(window);
 	if (gl_context == NULL){
@@ -191,35 +353,27 @@ SDL_AppResult SDL_AppInit(void **appstate, int argc, char *argv[]){
 	
 	int version = gladLoadGL((GLADloadfunc) SDL_GL_GetProcAddress);
     printf("GL %d.%d\n", GLAD_VERSION_MAJOR(version), GLAD_VERSION_MINOR(version));
+	EnableGLDebugOutput();
+
+	char* prefPath = SDL_GetPrefPath("SDL3_shader", "program_cache");
+	if (prefPath) {
+		InitProgramCache(prefPath, PROGRAM_CACHE_MAX_BYTES);
+		SDL_free(prefPath);
+	}
 	
 	glEnable(GL_BLEND);
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 	
 	shaderProgram = LoadDefaultShader();
+	ReflectProgram(shaderProgram, &shaderUniforms);
+	InitShaderCompiler(window, gl_context);
 	
-	float vertices[] = {
-		// Pos      // UV (Texture Coords)
-		-1.0f,  1.0f,  0.0f, 1.0f, // Top-Left
-		1.0f,  1.0f,  1.0f, 1.0f, // Top-Right
-		1.0f, -1.0f,  1.0f, 0.0f, // Bottom-Right
-
-		-1.0f,  1.0f,  0.0f, 1.0f, // Top-Left
-		1.0f, -1.0f,  1.0f, 0.0f, // Bottom-Right
-		-1.0f, -1.0f,  0.0f, 0.0f  // Bottom-Left
-	};
-
-	glGenVertexArrays(1, &VAO);
-	glGenBuffers(1, &VBO);
-
-	glBindVertexArray(VAO);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
-
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
-	glEnableVertexAttribArray(1);
+	CreateFullscreenQuad(&quad);
+	InitRenderScale(&renderScale);
+	InitTextureLoader();
+	InitFileWatcher();
+	InitProfiler();
+	loadWakeEvent = SDL_RegisterEvents(1);
 
     IMGUI_CHECKVERSION();
     ImGui::CreateContext();
@@ -240,24 +394,44 @@ SDL_AppResult SDL_AppInit(void **appstate, int argc, char *argv[]){
     return SDL_APP_CONTINUE;
 }
 
+// Picks the main callback rate: the display rate while something can change,
+// otherwise only wake up for events.
+static void UpdateFramePacing(){
+    bool compiling = pendingShaderReload || IsShaderCompilePending() || IsTextureLoadPending();
+    bool animated = ProgramUsesTime(shaderUniforms) || MultipassHasBuffers(&multipass);
+    bool active = compiling || (!windowOccluded && (animated || redrawFrames > 0));
+    const std::string& rate = active ? activeRate : std::string("waitevent");
+    if (rate != currentRate) {
+        currentRate = rate;
+        SDL_SetHint(SDL_HINT_MAIN_CALLBACK_RATE, currentRate.c_str());
+    }
+}
+
 /* updates on event */
 SDL_AppResult SDL_AppEvent(void *appstate, SDL_Event *event){
+    ProfileScope scope("events");
     ImGui_ImplSDL3_ProcessEvent(event);
+    redrawFrames = REDRAW_FRAMES_AFTER_EVENT;
     if (event->type == SDL_EVENT_QUIT) {
         return SDL_APP_SUCCESS; 
     }
+    switch (event->type) {
+        case SDL_EVENT_WINDOW_OCCLUDED:
+        case SDL_EVENT_WINDOW_MINIMIZED:
+        case SDL_EVENT_WINDOW_HIDDEN:
+            windowOccluded = true;
+            break;
+        case SDL_EVENT_WINDOW_EXPOSED:
+        case SDL_EVENT_WINDOW_RESTORED:
+        case SDL_EVENT_WINDOW_SHOWN:
+            windowOccluded = false;
+            break;
+        default:
+            break;
+    }
     if (event->type == SDL_EVENT_DROP_FILE){
         SDL_Log("%s",event->drop.data);
-        const char* load_path = event->drop.data;
-        size_t fileSize = 0;
-        void* fileData = SDL_LoadFile(load_path, &fileSize);
-        if (fileData == NULL) {
-            SDL_Log("Error loading file: ",SDL_GetError()); 
-            return SDL_APP_CONTINUE;
-        }
-        defaultFragmentShader = std::string((char*)fileData, fileSize);
-        SDL_free(fileData);
-        pendingShaderReload = true;
+        RequestLoad(event->drop.data);
     }
     if (event->type == SDL_EVENT_MOUSE_BUTTON_DOWN) {
         if (event->button.button == SDL_BUTTON_LEFT) {
@@ -277,23 +451,61 @@ SDL_AppResult SDL_AppEvent(void *appstate, SDL_Event *event){
 
 /* loop */
 SDL_AppResult SDL_AppIterate(void *appstate){
+    BeginProfileScope("shader reload");
+    std::string loadPath;
+    int loadChannel = -1;
+    {
+        std::lock_guard<std::mutex> lock(loadMutex);
+        loadPath.swap(pendingLoadPath);
+        loadChannel = pendingLoadChannel;
+    }
+    if (!loadPath.empty()) {
+        LoadShaderOrProject(loadPath, loadChannel);
+    }
+    std::vector<std::string> changedFiles = TakeChangedFiles();
+    if (!changedFiles.empty()) {
+        ReloadChangedFiles(changedFiles);
+    }
+    UpdateTextureLoader();
     if (pendingShaderReload) {
-        GLuint newProg = LoadDefaultShader();
-        if (newProg != 0) {
-            glDeleteProgram(shaderProgram);
-            shaderProgram = newProg;
-        }
+        // keeps drawing the current program until the new one is linked
+        SubmitShaderCompile(Pass_Image, defaultVertexShader, defaultFragmentShader, &multipass.manifest.passes[Pass_Image].sourceMap);
         pendingShaderReload = false;
     }
+    GLuint newProg = 0;
+    if (PollShaderCompile(Pass_Image, &newProg)) {
+        glDeleteProgram(shaderProgram);
+        shaderProgram = newProg;
+        ReflectProgram(shaderProgram, &shaderUniforms);
+        shaderLog.clear();
+        show_shader_log = false;
+    }
+    PollMultipassCompile(&multipass);
+    for (const std::string& log : TakeShaderLogs()) {
+        std::cerr << log;
+        shaderLog = log;
+        show_shader_log = true;
+    }
+    EndProfileScope();
+
+    UpdateFramePacing();
+    if (windowOccluded) {
+        return SDL_APP_CONTINUE; // nobody can see it
+    }
+    if (redrawFrames > 0) {
+        redrawFrames--;
+    }
 
     float time = SDL_GetTicks()/1000.0f; 
+    float timeDelta = time - lastFrameTime;
+    lastFrameTime = time;
 	int w, h;
     float x,y;
     SDL_MouseButtonFlags buttonState = SDL_GetMouseState(&x,&y);
     
 	SDL_GetWindowSize(window, &w, &h);
-	glViewport(0, 0, w, h);
 	
+    BeginProfileScope("ui");
     ImGui_ImplOpenGL3_NewFrame();
     ImGui_ImplSDL3_NewFrame();
     ImGui::NewFrame();
@@ -305,15 +517,25 @@ SDL_AppResult SDL_AppIterate(void *appstate){
     bool request_quit = ImGui::Shortcut((ImGuiKey_Q|ImGuiMod_Ctrl),ImGuiInputFlags_RouteGlobal);
     bool request_editor = ImGui::Shortcut((ImGuiKey_E|ImGuiMod_Ctrl),ImGuiInputFlags_RouteGlobal);
     if(ImGui::Shortcut((ImGuiKey_F12),ImGuiInputFlags_RouteGlobal)){
-        show_metrics = !show_metrics;
+        show_profiler = !show_profiler;
+    }
+    if(show_profiler && DrawProfilerWindow(&show_profiler)){
+        SDL_ShowSaveFileDialog(trace_save_callback, NULL, window, trace_filters, SDL_arraysize(trace_filters), "trace.json");
     }
     if(show_metrics){
-        ImGui::ShowMetricsWindow();
+        ImGui::ShowMetricsWindow(&show_metrics);
+    }
+    if(show_shader_log){
+        if(ImGui::Begin("Shader Log", &show_shader_log)){
+            ImGui::TextUnformatted(shaderLog.c_str());
+        }
+        ImGui::End();
     }
     if(ImGui::BeginMainMenuBar()){
         if (ImGui::BeginMenu("File")) {
             
-            if (ImGui::MenuItem("Save Shader", "Ctrl+S")||request_save) {request_save = true;}
+            // a project is several files, there is no single text to save
+            if (ImGui::MenuItem("Save Shader", "Ctrl+S", false, projectPath.empty())||request_save) {request_save = true;}
             if (ImGui::MenuItem("Load Shader", "Ctrl+O")||request_load) {request_load = true;}
             
             ImGui::Separator();
@@ -321,11 +543,45 @@ SDL_AppResult SDL_AppIterate(void *appstate){
             if (ImGui::MenuItem("Quit", "Ctrl+Q")||request_quit) { request_quit=true; }
             ImGui::EndMenu();
         }
+        if (ImGui::BeginMenu("View")) {
+            ImGui::MenuItem("Dynamic Resolution", NULL, &renderScale.dynamic);
+            if (renderScale.dynamic) {
+                ImGui::SliderFloat("Target GPU ms", &renderScale.targetMs, 1.0f, 33.0f, "%.1f");
+            }
+            ImGui::SliderFloat("Render Scale", &renderScale.scale, renderScale.minScale, 1.0f, "%.2f");
+            ImGui::Text("Shader pass %.2f ms", renderScale.gpuMs);
+            ImGui::Separator();
+            ImGui::MenuItem("Profiler", "F12", &show_profiler);
+            ImGui::MenuItem("ImGui Metrics", NULL, &show_metrics);
+            ImGui::EndMenu();
+        }
+        if (ImGui::BeginMenu("Channels")) {
+            for (int c = 0; c < CHANNEL_COUNT; c++) {
+                const ChannelInput& channel = multipass.manifest.passes[Pass_Image].channels[c];
+                std::string label = "iChannel" + std::to_string(c) + ": " + ChannelLabel(channel);
+                if (ImGui::BeginMenu(label.c_str())) {
+                    if (ImGui::MenuItem("Load Texture...")) {
+                        SDL_ShowOpenFileDialog(channel_load_callback, (void*)(intptr_t)c, window, texture_filters, SDL_arraysize(texture_filters), NULL, false);
+                    }
+                    if (ImGui::MenuItem("Clear", NULL, false, channel.kind != Channel_None)) {
+                        SetPassChannelTexture(&multipass, Pass_Image, c, "");
+                    }
+                    ImGui::EndMenu();
+                }
+            }
+            ImGui::EndMenu();
+        }
+        if (IsShaderCompilePending()) {
+            ImGui::TextDisabled("compiling...");
+        }
         ImGui::EndMainMenuBar();
     }
+    EndProfileScope();
 
-    if(request_save){
-        SDL_ShowSaveFileDialog(save_callback, NULL, window, file_filters, SDL_arraysize(file_filters), NULL);
+    if(request_save && projectPath.empty()){
+        const PassDesc& image = multipass.manifest.passes[Pass_Image];
+        std::string* text = new std::string(image.sourcePath.empty() ? defaultFragmentShader : image.rawSource);
+        SDL_ShowSaveFileDialog(save_callback, text, window, file_filters, SDL_arraysize(file_filters), NULL);
     }
     if(request_load){
         SDL_ShowOpenFileDialog(load_callback, NULL, window, file_filters, SDL_arraysize(file_filters), NULL,false);
@@ -336,58 +592,63 @@ SDL_AppResult SDL_AppIterate(void *appstate){
     if(request_quit){
         return SDL_APP_SUCCESS;
     }
+    ShaderInputs inputs;
+    inputs.time = time;
+    inputs.timeDelta = timeDelta;
+    inputs.frameRate = timeDelta > 0.0f ? 1.0f / timeDelta : 0.0f;
+    inputs.frame = frameCount++;
+    inputs.width = (float)w;
+    inputs.height = (float)h;
+    inputs.mouseX = x;
+    inputs.mouseY = y;
+    inputs.clickX = clickX;
+    inputs.clickY = clickY;
+    inputs.mouseDown = isLeftDown;
+    SDL_Time now;
+    SDL_DateTime date;
+    if (SDL_GetCurrentTime(&now) && SDL_TimeToDateTime(now, &date, true)) {
+        inputs.date[0] = (float)date.year;
+        inputs.date[1] = (float)(date.month - 1);
+        inputs.date[2] = (float)date.day;
+        inputs.date[3] = date.hour * 3600.0f + date.minute * 60.0f + date.second + date.nanosecond / 1e9f;
+    }
+    BeginGpuPass();
+    // buffers follow the window, not the render scale: a resize of a feedback
+    // buffer clears it, and scaling can't make their work cheaper anyway
+    BeginProfileScope("buffer passes");
+    RenderBufferPasses(&multipass, quad, inputs);
+    EndProfileScope();
+
+    int rw, rh;
+    BeginScaledPass(&renderScale, w, h, &rw, &rh);
+    
+    // the image pass sees the scaled target, mouse included
+    float sx = (float)rw / (float)w;
+    float sy = (float)rh / (float)h;
+    inputs.width = (float)rw;
+    inputs.height = (float)rh;
+    inputs.mouseX *= sx;
+    inputs.mouseY *= sy;
+    inputs.clickX *= sx;
+    inputs.clickY *= sy;
+    BindPassChannels(&multipass, Pass_Image, &inputs);
+
 	glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
 	glClear(GL_COLOR_BUFFER_BIT);
-    
-	glUseProgram(shaderProgram);
-	CheckGLError("glUseProgram");
-
-    glUniform1f(glGetUniformLocation(shaderProgram,"u_time"),time);
-    CheckGLError("glUniform1f");
-	glUniform2f(glGetUniformLocation(shaderProgram, "u_resolution"), (float)w, (float)h);
-	CheckGLError("glUniform2f");
-    glUniform2f(glGetUniformLocation(shaderProgram,"u_mouse"),x,y);
-    CheckGLError("glUniform2f");
-
-    // shadertoy uniforms
-    // uniform vec3      iResolution;           // viewport resolution (in pixels)
-    glUniform3f(glGetUniformLocation(shaderProgram,"iResolution"),(float)w,(float)h,1.0f);
-    CheckGLError("glUniform3f");
-    // uniform float     iTime;                 // shader playback time (in seconds)
-    glUniform1f(glGetUniformLocation(shaderProgram,"iTime"),time);
-    CheckGLError("glUniform1f");
-    // uniform float     iTimeDelta;            // render time (in seconds)
-    // uniform float     iFrameRate;            // shader frame rate
-    // uniform int       iFrame;                // shader playback frame
-    // uniform float     iChannelTime[4];       // channel playback time (in seconds)
-    // uniform vec3      iChannelResolution[4]; // channel resolution (in pixels)
-    // uniform vec4      iMouse;                // mouse pixel coords. xy: current (if MLB down), zw: click
-    // Flip Y to match Shadertoy
-    float currentY = h - (float)y;
-    float lastClickY = h - clickY;
-
-    if (isLeftDown) {   
-        // While button is down: xy = current pos, zw = start pos
-        glUniform4f(glGetUniformLocation(shaderProgram, "iMouse"), (float)x, currentY, clickX, lastClickY);
-    } else {
-    // Shadertoy standard: zw becomes negative (or remains last click) when up
-    // Usually, you just pass the last coordinates with a negative sign or flag
-        glUniform4f(glGetUniformLocation(shaderProgram, "iMouse"), 
-                (float)x, currentY, -clickX, -lastClickY);
-    }
-    CheckGLError("glUniform4f");
-    // uniform samplerXX iChannel0..3;          // input channel. XX = 2D/Cube
-    // uniform vec4      iDate;                 // (year, month, day, time in seconds)
-    // uniform float     iSampleRate;           // sound sample rate (i.e., 44100)
-
-	glBindVertexArray(VAO);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
+    if (shaderProgram != 0) {
+        DrawShaderQuad(shaderProgram, shaderUniforms, quad, inputs);
+    }
+    EndScaledPass(&renderScale, w, h, rw, rh);
+    EndGpuPass();
 	
     // Rendering
     ImGuiIO& io = ImGui::GetIO();
+    BeginProfileScope("imgui render");
     ImGui::Render();
 	ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+    EndProfileScope();
     if (io.ConfigFlags & ImGuiConfigFlags_ViewportsEnable){
+        ProfileScope viewports("viewports"); // a context switch per platform window
         SDL_Window* backup_current_window = SDL_GL_GetCurrentWindow();
         SDL_GLContext backup_current_context = SDL_GL_GetCurrentContext();
     
@@ -396,14 +657,25 @@ SDL_AppResult SDL_AppIterate(void *appstate){
     
         SDL_GL_MakeCurrent(backup_current_window, backup_current_context);
     }
+    BeginProfileScope("swap");
 	SDL_GL_SwapWindow(window);
+    EndProfileScope();
+    EndProfileFrame();
     return SDL_APP_CONTINUE;
 }
 
 /* This function runs once at shutdown. */
 void SDL_AppQuit(void *appstate, SDL_AppResult result){
-	glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
+    if (gl_context == NULL) { // headless runs never create the window context
+        return;
+    }
+	ShutdownProfiler();
+	ShutdownFileWatcher();
+	ShutdownShaderCompiler();
+	DestroyMultipass(&multipass);
+	ShutdownTextureLoader();
+	DestroyRenderScale(&renderScale);
+	DestroyFullscreenQuad(&quad);
     glDeleteProgram(shaderProgram);
     SDL_GL_DestroyContext(gl_context);
     SDL_DestroyWindow(window);
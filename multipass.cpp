@@ -0,0 +1,461 @@
+#include "multipass.h"
+#include "shader_compiler.h"
+#include "texture_loader.h"
+#include <SDL3/SDL.h>
+#include <math.h>
+#include <sstream>
+
+// Manifest ////
+static const char* kPassNames[Pass_COUNT] = { "Image", "BufferA", "BufferB", "BufferC", "BufferD" };
+
+static std::string Trim(const std::string& s){
+    size_t start = s.find_first_not_of(" \t\r\n");
+    if (start == std::string::npos) {
+        return "";
+    }
+    size_t end = s.find_last_not_of(" \t\r\n");
+    return s.substr(start, end - start + 1);
+}
+
+static int FindPass(const std::string& name){
+    for (int p = 0; p < Pass_COUNT; p++) {
+        if (SDL_strcasecmp(name.c_str(), kPassNames[p]) == 0) {
+            return p;
+        }
+    }
+    return -1;
+}
+
+static bool IsAbsolutePath(const std::string& path){
+    return (!path.empty() && (path[0] == '/' || path[0] == '\\')) || (path.size() > 1 && path[1] == ':');
+}
+
+static std::string DirectoryOf(const std::string& path){
+    size_t slash = path.find_last_of("/\\");
+    return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+}
+
+// Expanded text for the compiler, raw text for saving.
+static bool ReadPassSource(PassDesc* pass, std::string* error){
+    if (!ExpandShader(pass->sourcePath, &pass->source, &pass->sourceMap, error)) {
+        return false;
+    }
+    size_t fileSize = 0;
+    void* fileData = SDL_LoadFile(pass->sourcePath.c_str(), &fileSize);
+    if (fileData == NULL) {
+        *error = pass->sourcePath + ": " + SDL_GetError();
+        return false;
+    }
+    pass->rawSource.assign((const char*)fileData, fileSize);
+    SDL_free(fileData);
+    return true;
+}
+
+static bool LoadPassSource(const std::string& directory, PassDesc* pass){
+    pass->sourcePath = NormalizeShaderPath(IsAbsolutePath(pass->sourcePath) ? pass->sourcePath : directory + pass->sourcePath);
+    std::string error;
+    if (!ReadPassSource(pass, &error)) {
+        SDL_Log("%s", error.c_str());
+        return false;
+    }
+    return true;
+}
+
+static bool ParseChannel(const std::string& directory, const std::string& value, ChannelInput* channel){
+    *channel = ChannelInput();
+    if (value.empty() || SDL_strcasecmp(value.c_str(), "none") == 0) {
+        return true;
+    }
+    int pass = FindPass(value);
+    if (pass >= Pass_BufferA) {
+        channel->kind = Channel_Buffer;
+        channel->buffer = pass - Pass_BufferA;
+        return true;
+    }
+    if (IsTextureFile(value)) {
+        channel->kind = Channel_Texture;
+        channel->texturePath = IsAbsolutePath(value) ? value : directory + value;
+        return true;
+    }
+    return false;
+}
+
+bool LoadProjectManifest(const char* path, ProjectManifest* manifest){
+    size_t fileSize = 0;
+    void* fileData = SDL_LoadFile(path, &fileSize);
+    if (fileData == NULL) {
+        SDL_Log("Error loading file: %s", SDL_GetError());
+        return false;
+    }
+    std::istringstream lines(std::string((char*)fileData, fileSize));
+    SDL_free(fileData);
+
+    *manifest = ProjectManifest();
+    manifest->path = path;
+    std::string directory = DirectoryOf(path);
+    PassDesc* current = NULL;
+    std::string line;
+    int lineNumber = 0;
+    bool ok = true;
+    while (std::getline(lines, line)) {
+        lineNumber++;
+        line = Trim(line);
+        // comments take the whole line, so values may contain '#' and ';'
+        if (line.empty() || line.front() == '#' || line.front() == ';') {
+            continue;
+        }
+        if (line.front() == '[' && line.back() == ']') {
+            int pass = FindPass(Trim(line.substr(1, line.size() - 2)));
+            if (pass < 0) {
+                SDL_Log("%s:%d: unknown pass %s", path, lineNumber, line.c_str());
+                ok = false;
+                current = NULL;
+                continue;
+            }
+            current = &manifest->passes[pass];
+            current->enabled = true;
+            continue;
+        }
+        size_t equals = line.find('=');
+        if (current == NULL || equals == std::string::npos) {
+            SDL_Log("%s:%d: expected 'key = value' inside a [pass] section", path, lineNumber);
+            ok = false;
+            continue;
+        }
+        std::string key = Trim(line.substr(0, equals));
+        std::string value = Trim(line.substr(equals + 1));
+        int channel = -1;
+        if (key == "source") {
+            current->sourcePath = value;
+        } else if (SDL_sscanf(key.c_str(), "iChannel%d", &channel) == 1 && channel >= 0 && channel < CHANNEL_COUNT) {
+            if (!ParseChannel(directory, value, &current->channels[channel])) {
+                SDL_Log("%s:%d: unknown channel input '%s'", path, lineNumber, value.c_str());
+                ok = false;
+            }
+        } else if (key == "size") {
+            if (SDL_sscanf(value.c_str(), "%dx%d", &current->width, &current->height) != 2) {
+                SDL_Log("%s:%d: size must look like 512x512", path, lineNumber);
+                ok = false;
+            }
+        } else if (key == "scale") {
+            current->scale = (float)SDL_atof(value.c_str());
+        } else {
+            SDL_Log("%s:%d: unknown key '%s'", path, lineNumber, key.c_str());
+            ok = false;
+        }
+    }
+
+    for (int p = 0; p < Pass_COUNT && ok; p++) {
+        PassDesc& pass = manifest->passes[p];
+        if (!pass.enabled) {
+            continue;
+        }
+        if (pass.sourcePath.empty()) {
+            SDL_Log("%s: [%s] has no source", path, kPassNames[p]);
+            ok = false;
+        } else {
+            ok = LoadPassSource(directory, &pass);
+        }
+    }
+    if (ok && !manifest->passes[Pass_Image].enabled) {
+        SDL_Log("%s: an [Image] pass is required", path);
+        ok = false;
+    }
+    return ok;
+}
+
+// Targets ////
+static void ClearTarget(PingPongTarget* target){
+    GLint previous = 0;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previous);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    for (int i = 0; i < 2; i++) {
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target->fbos[i]);
+        glClear(GL_COLOR_BUFFER_BIT);
+    }
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, (GLuint)previous);
+}
+
+static void ResizeTarget(PingPongTarget* target, int width, int height){
+    if (target->textures[0] != 0 && target->width == width && target->height == height) {
+        return;
+    }
+    if (target->textures[0] == 0) {
+        glGenTextures(2, target->textures);
+        glGenFramebuffers(2, target->fbos);
+    }
+    GLint previous = 0;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previous);
+    for (int i = 0; i < 2; i++) {
+        glBindTexture(GL_TEXTURE_2D, target->textures[i]);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, width, height, 0, GL_RGBA, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target->fbos[i]);
+        glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target->textures[i], 0);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, (GLuint)previous);
+    target->width = width;
+    target->height = height;
+    target->front = 0;
+    ClearTarget(target);
+}
+
+static void DestroyTarget(PingPongTarget* target){
+    glDeleteFramebuffers(2, target->fbos);
+    glDeleteTextures(2, target->textures);
+    *target = PingPongTarget();
+}
+
+// Passes ////
+static bool ReadsBuffer(const PassDesc& pass, int buffer){
+    for (int c = 0; c < CHANNEL_COUNT; c++) {
+        if (pass.channels[c].kind == Channel_Buffer && pass.channels[c].buffer == buffer) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Kahn's algorithm over "reads another buffer" edges, manifest order breaks
+// ties. Buffers caught in a cycle go last and see each other's previous frame.
+static void BuildPassOrder(Multipass* mp){
+    bool placed[BUFFER_COUNT] = {};
+    mp->orderCount = 0;
+    for (;;) {
+        int next = -1;
+        for (int b = 0; b < BUFFER_COUNT && next < 0; b++) {
+            const PassDesc& pass = mp->manifest.passes[Pass_BufferA + b];
+            if (!pass.enabled || placed[b]) {
+                continue;
+            }
+            bool ready = true;
+            for (int dep = 0; dep < BUFFER_COUNT; dep++) {
+                bool depEnabled = mp->manifest.passes[Pass_BufferA + dep].enabled;
+                if (dep != b && depEnabled && !placed[dep] && ReadsBuffer(pass, dep)) {
+                    ready = false;
+                }
+            }
+            if (ready) {
+                next = b;
+            }
+        }
+        if (next < 0) {
+            break;
+        }
+        placed[next] = true;
+        mp->order[mp->orderCount++] = next;
+    }
+    for (int b = 0; b < BUFFER_COUNT; b++) {
+        if (mp->manifest.passes[Pass_BufferA + b].enabled && !placed[b]) {
+            mp->order[mp->orderCount++] = b;
+        }
+    }
+}
+
+static void DeletePrograms(Multipass* mp){
+    for (int b = 0; b < BUFFER_COUNT; b++) {
+        glDeleteProgram(mp->programs[b]);
+        mp->programs[b] = 0;
+        mp->reflections[b] = ProgramReflection();
+    }
+}
+
+static void RequestPassTextures(PassDesc* pass){
+    for (int c = 0; c < CHANNEL_COUNT; c++) {
+        ChannelInput& channel = pass->channels[c];
+        if (channel.kind == Channel_Texture && channel.texture < 0) {
+            channel.texture = RequestTexture(channel.texturePath);
+        }
+    }
+}
+
+static void ReleasePassTextures(PassDesc* pass){
+    for (int c = 0; c < CHANNEL_COUNT; c++) {
+        ChannelInput& channel = pass->channels[c];
+        if (channel.kind == Channel_Texture && channel.texture >= 0) {
+            ReleaseTexture(channel.texture);
+            channel.texture = -1;
+        }
+    }
+}
+
+void SetMultipassProject(Multipass* mp, const ProjectManifest& manifest, const std::string& vertexSource){
+    DeletePrograms(mp);
+    // request before releasing so textures both projects use are kept
+    ProjectManifest previous = mp->manifest;
+    mp->manifest = manifest;
+    for (int p = 0; p < Pass_COUNT; p++) {
+        RequestPassTextures(&mp->manifest.passes[p]);
+    }
+    for (int p = 0; p < Pass_COUNT; p++) {
+        ReleasePassTextures(&previous.passes[p]);
+    }
+    BuildPassOrder(mp);
+    for (int b = 0; b < BUFFER_COUNT; b++) {
+        const PassDesc& pass = manifest.passes[Pass_BufferA + b];
+        if (pass.enabled) {
+            SubmitShaderCompile(Pass_BufferA + b, vertexSource, pass.source, &pass.sourceMap);
+        }
+        if (mp->targets[b].textures[0] != 0) {
+            ClearTarget(&mp->targets[b]); // new project starts from black
+        }
+    }
+}
+
+void ClearMultipass(Multipass* mp){
+    DeletePrograms(mp);
+    PassDesc image = mp->manifest.passes[Pass_Image];
+    for (int p = Pass_BufferA; p < Pass_COUNT; p++) {
+        ReleasePassTextures(&mp->manifest.passes[p]);
+    }
+    mp->manifest = ProjectManifest();
+    mp->orderCount = 0;
+    for (int c = 0; c < CHANNEL_COUNT; c++) {
+        if (image.channels[c].kind == Channel_Texture) {
+            mp->manifest.passes[Pass_Image].channels[c] = image.channels[c];
+        }
+    }
+}
+
+void DestroyMultipass(Multipass* mp){
+    for (int p = 0; p < Pass_COUNT; p++) {
+        ReleasePassTextures(&mp->manifest.passes[p]);
+    }
+    ClearMultipass(mp);
+    for (int b = 0; b < BUFFER_COUNT; b++) {
+        DestroyTarget(&mp->targets[b]);
+    }
+}
+
+bool MultipassHasBuffers(const Multipass* mp){
+    return mp->orderCount > 0;
+}
+
+void SetPassChannelTexture(Multipass* mp, PassId pass, int channel, const std::string& path){
+    if (channel < 0 || channel >= CHANNEL_COUNT) {
+        return;
+    }
+    ChannelInput& input = mp->manifest.passes[pass].channels[channel];
+    ChannelInput previous = input;
+    input = ChannelInput();
+    if (!path.empty()) {
+        input.kind = Channel_Texture;
+        input.texturePath = path;
+        input.texture = RequestTexture(path);
+    }
+    if (previous.kind == Channel_Texture && previous.texture >= 0) {
+        ReleaseTexture(previous.texture);
+    }
+    if (previous.kind == Channel_Buffer) {
+        BuildPassOrder(mp);
+    }
+}
+
+bool ReloadPassSource(Multipass* mp, PassId pass, const std::string& vertexSource, std::string* error){
+    PassDesc& desc = mp->manifest.passes[pass];
+    if (!ReadPassSource(&desc, error)) {
+        return false;
+    }
+    if (pass != Pass_Image) {
+        SubmitShaderCompile(pass, vertexSource, desc.source, &desc.sourceMap);
+    }
+    return true;
+}
+
+void PollMultipassCompile(Multipass* mp){
+    for (int b = 0; b < BUFFER_COUNT; b++) {
+        GLuint program = 0;
+        if (PollShaderCompile(Pass_BufferA + b, &program)) {
+            glDeleteProgram(mp->programs[b]);
+            mp->programs[b] = program;
+            ReflectProgram(program, &mp->reflections[b]);
+        }
+    }
+}
+
+void BindPassChannels(const Multipass* mp, PassId pass, ShaderInputs* in){
+    const PassDesc& desc = mp->manifest.passes[pass];
+    for (int c = 0; c < CHANNEL_COUNT; c++) {
+        const ChannelInput& channel = desc.channels[c];
+        GLuint texture = 0;
+        GLuint64 handle = 0;
+        float width = 0.0f, height = 0.0f;
+        TextureInfo info;
+        if (channel.kind == Channel_Buffer && channel.buffer >= 0 && channel.buffer < BUFFER_COUNT) {
+            const PingPongTarget& target = mp->targets[channel.buffer];
+            texture = target.textures[target.front];
+            width = (float)target.width;
+            height = (float)target.height;
+        } else if (channel.kind == Channel_Texture && GetTexture(channel.texture, &info)) {
+            texture = info.texture;
+            handle = info.handle;
+            width = (float)info.width;
+            height = (float)info.height;
+        }
+        in->channels[c] = texture;
+        in->channelHandles[c] = handle;
+        in->channelResolution[c][0] = width;
+        in->channelResolution[c][1] = height;
+        in->channelResolution[c][2] = 1.0f;
+    }
+}
+
+void RenderBufferPasses(Multipass* mp, const ShaderQuad& quad, const ShaderInputs& frame){
+    if (mp->orderCount == 0) {
+        return;
+    }
+    GLint previousFbo = 0;
+    GLint viewport[4];
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFbo);
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    GLboolean blend = glIsEnabled(GL_BLEND);
+    glDisable(GL_BLEND); // buffers store raw values, feedback must not blend
+
+    // size everything first so channels always see allocated targets
+    for (int i = 0; i < mp->orderCount; i++) {
+        int b = mp->order[i];
+        const PassDesc& pass = mp->manifest.passes[Pass_BufferA + b];
+        int width = pass.width;
+        int height = pass.height;
+        if (width <= 0 || height <= 0) {
+            width = (int)fmaxf(1.0f, floorf(frame.width * pass.scale));
+            height = (int)fmaxf(1.0f, floorf(frame.height * pass.scale));
+        }
+        ResizeTarget(&mp->targets[b], width, height);
+    }
+
+    for (int i = 0; i < mp->orderCount; i++) {
+        int b = mp->order[i];
+        if (mp->programs[b] == 0) {
+            continue; // still compiling, keeps its last frame
+        }
+        PingPongTarget& target = mp->targets[b];
+        float sx = (float)target.width / frame.width;
+        float sy = (float)target.height / frame.height;
+        ShaderInputs in = frame;
+        in.width = (float)target.width;
+        in.height = (float)target.height;
+        in.mouseX *= sx;
+        in.mouseY *= sy;
+        in.clickX *= sx;
+        in.clickY *= sy;
+        BindPassChannels(mp, (PassId)(Pass_BufferA + b), &in);
+
+        int back = 1 - target.front;
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target.fbos[back]);
+        glViewport(0, 0, target.width, target.height);
+        DrawShaderQuad(mp->programs[b], mp->reflections[b], quad, in);
+        target.front = back;
+    }
+
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, (GLuint)previousFbo);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    if (blend) {
+        glEnable(GL_BLEND);
+    }
+}
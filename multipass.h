@@ -0,0 +1,109 @@
+#pragma once
+#include "renderer.h"
+#include "shader_preprocessor.h"
+#include <string>
+
+// Shadertoy-style multipass: up to four buffer passes rendered into float
+// targets before the image pass. Every iChannel can read any buffer; a buffer
+// that hasn't run yet this frame (itself included) yields its previous frame.
+// Channels can also read image files, loaded through texture_loader.h.
+enum PassId {
+    Pass_Image,     // drawn into the window, uses shader slot 0 like a single shader
+    Pass_BufferA,
+    Pass_BufferB,
+    Pass_BufferC,
+    Pass_BufferD,
+    Pass_COUNT
+};
+
+static const int BUFFER_COUNT = 4;
+static const int CHANNEL_COUNT = 4;
+
+enum ChannelKind {
+    Channel_None,
+    Channel_Buffer,
+    Channel_Texture
+};
+
+struct ChannelInput {
+    ChannelKind kind = Channel_None;
+    int buffer = -1;            // 0..3 for Buffer A..D
+    std::string texturePath;
+    int texture = -1;           // texture loader id, -1 until requested
+};
+
+struct PassDesc {
+    bool enabled = false;
+    std::string sourcePath;
+    std::string source;     // with #includes expanded, what gets compiled
+    std::string rawSource;  // the file as on disk, what gets saved
+    SourceMap sourceMap;
+    ChannelInput channels[CHANNEL_COUNT];
+    int width = 0;          // fixed buffer size, 0 follows the window size
+    int height = 0;
+    float scale = 1.0f;     // of the window size when no fixed size is given
+};
+
+// Per-project manifest, ini style, paths relative to the manifest.
+// Pass sources may #include shared files (shader_preprocessor.h):
+//   [BufferA]
+//   source = feedback.glsl
+//   iChannel0 = BufferA
+//   iChannel1 = noise.png (png, jpg or dds)
+//   size = 512x512        (or: scale = 0.5)
+//   [Image]
+//   source = image.glsl
+//   iChannel0 = BufferA
+struct ProjectManifest {
+    std::string path;
+    PassDesc passes[Pass_COUNT];
+};
+
+bool LoadProjectManifest(const char* path, ProjectManifest* manifest);
+
+// Two textures per buffer; `front` holds the newest finished frame.
+struct PingPongTarget {
+    GLuint textures[2] = {};
+    GLuint fbos[2] = {};
+    int front = 0;
+    int width = 0;
+    int height = 0;
+};
+
+struct Multipass {
+    ProjectManifest manifest;
+    GLuint programs[BUFFER_COUNT] = {};
+    ProgramReflection reflections[BUFFER_COUNT];
+    PingPongTarget targets[BUFFER_COUNT];   // pooled, reallocated only on resize
+    int order[BUFFER_COUNT] = {};           // buffers in dependency order
+    int orderCount = 0;
+};
+
+// Takes over the buffer passes of `manifest` and submits their shaders to the
+// compiler; the image pass stays with the caller.
+void SetMultipassProject(Multipass* mp, const ProjectManifest& manifest, const std::string& vertexSource);
+// Drops the buffer passes. Textures on the image pass stay, so a plain shader
+// keeps its iChannels across reloads.
+void ClearMultipass(Multipass* mp);
+void DestroyMultipass(Multipass* mp);
+bool MultipassHasBuffers(const Multipass* mp);
+
+// Points one channel of `pass` at an image file, an empty path clears it.
+void SetPassChannelTexture(Multipass* mp, PassId pass, int channel, const std::string& path);
+
+// Re-expands the source of `pass` from its file and, for buffers, submits it
+// to the compiler. The image pass stays with the caller.
+bool ReloadPassSource(Multipass* mp, PassId pass, const std::string& vertexSource, std::string* error);
+
+// Picks up finished buffer programs, call once per frame.
+void PollMultipassCompile(Multipass* mp);
+
+// Renders the buffer passes. Restores the bound draw framebuffer, viewport
+// and blend state afterwards. `frame` is in window space, not the scaled
+// render target, so a changing render scale never reallocates (and clears)
+// a buffer; each pass gets its own size as iResolution.
+void RenderBufferPasses(Multipass* mp, const ShaderQuad& quad, const ShaderInputs& frame);
+
+// Fills iChannel textures and resolutions for `pass` from the newest buffer
+// frames and the loaded textures; textures still loading read as black.
+void BindPassChannels(const Multipass* mp, PassId pass, ShaderInputs* in);
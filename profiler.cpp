@@ -0,0 +1,368 @@
+#include "profiler.h"
+#include <glad/gl.h>
+#include "imgui.h"
+#include <atomic>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static const int MAX_SCOPE_DEPTH = 16;
+static const int GPU_QUERY_FRAMES = 2;      // one pair in flight while the other is read
+static const int GPU_CALIBRATE_FRAMES = 120;
+static const int HUD_FRAMES = 240;
+
+// Frame ring ////
+// Single writer seqlock per slot: the sequence is odd while the record is
+// being written and 2 * (frame + 1) once it holds that frame. Readers copy
+// the record and keep it only if the sequence was the same even value before
+// and after.
+struct RingSlot {
+    std::atomic<Uint64> sequence{0};
+    FrameRecord record;
+};
+
+static RingSlot ring[PROFILER_FRAMES];
+static std::atomic<Uint64> framesPublished{0};
+
+static Uint64 CompleteSequence(Uint64 frame){
+    return 2 * (frame + 1);
+}
+
+static void PublishFrame(const FrameRecord& record){
+    RingSlot& slot = ring[record.frame % PROFILER_FRAMES];
+    slot.sequence.store(CompleteSequence(record.frame) - 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.record = record;
+    slot.sequence.store(CompleteSequence(record.frame), std::memory_order_release);
+    framesPublished.store(record.frame + 1, std::memory_order_release);
+}
+
+// GPU results arrive a few frames late; the frame may have left the ring since.
+static void PublishGpuPass(Uint64 frame, Uint64 startNs, Uint64 endNs){
+    RingSlot& slot = ring[frame % PROFILER_FRAMES];
+    Uint64 complete = CompleteSequence(frame);
+    if (slot.sequence.load(std::memory_order_relaxed) != complete) {
+        return;
+    }
+    slot.sequence.store(complete - 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.record.gpuStartNs = startNs;
+    slot.record.gpuEndNs = endNs;
+    slot.sequence.store(complete, std::memory_order_release);
+}
+
+int ReadFrameRecords(FrameRecord* frames, int maxFrames){
+    Uint64 published = framesPublished.load(std::memory_order_acquire);
+    Uint64 wanted = (Uint64)SDL_min(maxFrames, PROFILER_FRAMES);
+    Uint64 first = published > wanted ? published - wanted : 0;
+    int count = 0;
+    for (Uint64 frame = first; frame < published; frame++) {
+        RingSlot& slot = ring[frame % PROFILER_FRAMES];
+        Uint64 before = slot.sequence.load(std::memory_order_acquire);
+        if (before != CompleteSequence(frame)) {
+            continue; // being written or already overwritten
+        }
+        frames[count] = slot.record;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) == before) {
+            count++;
+        }
+    }
+    return count;
+}
+
+// Recording ////
+static bool profilerEnabled = false;
+static FrameRecord current;
+static int scopeStack[MAX_SCOPE_DEPTH];
+static int scopeDepth = 0;
+
+struct GpuQueryPair {
+    GLuint begin = 0;
+    GLuint end = 0;
+    Uint64 frame = 0;
+    bool pending = false;
+};
+
+static GpuQueryPair gpuQueries[GPU_QUERY_FRAMES];
+static int gpuQueryIndex = 0;
+static bool gpuPassOpen = false;
+static bool gpuTimestamps = false;      // GL may report a zero-bit timestamp counter
+static Sint64 gpuClockOffsetNs = 0;     // CPU clock minus GL_TIMESTAMP clock
+
+static void CalibrateGpuClock(){
+    GLint64 gpuNs = 0;
+    glGetInteger64v(GL_TIMESTAMP, &gpuNs);
+    gpuClockOffsetNs = (Sint64)SDL_GetTicksNS() - (Sint64)gpuNs;
+}
+
+void InitProfiler(){
+    for (int i = 0; i < GPU_QUERY_FRAMES; i++) {
+        glGenQueries(1, &gpuQueries[i].begin);
+        glGenQueries(1, &gpuQueries[i].end);
+        gpuQueries[i].pending = false;
+    }
+    GLint counterBits = 0;
+    glGetQueryiv(GL_TIMESTAMP, GL_QUERY_COUNTER_BITS, &counterBits);
+    gpuTimestamps = counterBits > 0;
+    if (gpuTimestamps) {
+        CalibrateGpuClock();
+    }
+    current = FrameRecord();
+    current.frame = framesPublished.load(std::memory_order_relaxed);
+    current.startNs = SDL_GetTicksNS();
+    scopeDepth = 0;
+    profilerEnabled = true;
+}
+
+void ShutdownProfiler(){
+    if (!profilerEnabled) {
+        return;
+    }
+    for (int i = 0; i < GPU_QUERY_FRAMES; i++) {
+        glDeleteQueries(1, &gpuQueries[i].begin);
+        glDeleteQueries(1, &gpuQueries[i].end);
+    }
+    profilerEnabled = false;
+}
+
+void EndProfileFrame(){
+    if (!profilerEnabled) {
+        return;
+    }
+    Uint64 now = SDL_GetTicksNS();
+    while (scopeDepth > 0) {
+        EndProfileScope(); // unbalanced scopes close with the frame
+    }
+    current.endNs = now;
+    PublishFrame(current);
+
+    Uint64 next = current.frame + 1;
+    current.frame = next;
+    current.startNs = now;
+    current.gpuStartNs = 0;
+    current.gpuEndNs = 0;
+    current.scopeCount = 0;
+    current.droppedScopes = 0;
+    if (gpuTimestamps && next % GPU_CALIBRATE_FRAMES == 0) {
+        CalibrateGpuClock(); // the clocks drift apart slowly
+    }
+}
+
+void BeginProfileScope(const char* name){
+    if (!profilerEnabled || scopeDepth >= MAX_SCOPE_DEPTH) {
+        return;
+    }
+    int index = -1;
+    if (current.scopeCount < PROFILER_MAX_SCOPES) {
+        index = current.scopeCount++;
+        ProfileScopeRecord& scope = current.scopes[index];
+        scope.name = name;
+        scope.depth = scopeDepth;
+        scope.startNs = SDL_GetTicksNS();
+        scope.endNs = scope.startNs;
+    } else {
+        current.droppedScopes++;
+    }
+    scopeStack[scopeDepth++] = index;
+}
+
+void EndProfileScope(){
+    if (!profilerEnabled || scopeDepth == 0) {
+        return;
+    }
+    int index = scopeStack[--scopeDepth];
+    if (index >= 0) {
+        current.scopes[index].endNs = SDL_GetTicksNS();
+    }
+}
+
+// Reads every finished pair without waiting; a pair still in flight is left for later.
+static void CollectGpuQueries(){
+    for (int i = 0; i < GPU_QUERY_FRAMES; i++) {
+        GpuQueryPair& pair = gpuQueries[i];
+        if (!pair.pending) {
+            continue;
+        }
+        GLint available = GL_FALSE;
+        glGetQueryObjectiv(pair.end, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) {
+            continue;
+        }
+        GLuint64 beginNs = 0;
+        GLuint64 endNs = 0;
+        glGetQueryObjectui64v(pair.begin, GL_QUERY_RESULT, &beginNs);
+        glGetQueryObjectui64v(pair.end, GL_QUERY_RESULT, &endNs);
+        pair.pending = false;
+        PublishGpuPass(pair.frame, (Uint64)((Sint64)beginNs + gpuClockOffsetNs), (Uint64)((Sint64)endNs + gpuClockOffsetNs));
+    }
+}
+
+void BeginGpuPass(){
+    if (!profilerEnabled || !gpuTimestamps) {
+        return;
+    }
+    CollectGpuQueries();
+    GpuQueryPair& pair = gpuQueries[gpuQueryIndex];
+    gpuPassOpen = !pair.pending; // both pairs in flight: this frame goes unmeasured
+    if (gpuPassOpen) {
+        glQueryCounter(pair.begin, GL_TIMESTAMP);
+    }
+}
+
+void EndGpuPass(){
+    if (!profilerEnabled || !gpuPassOpen) {
+        return;
+    }
+    GpuQueryPair& pair = gpuQueries[gpuQueryIndex];
+    glQueryCounter(pair.end, GL_TIMESTAMP);
+    pair.frame = current.frame;
+    pair.pending = true;
+    gpuPassOpen = false;
+    gpuQueryIndex = (gpuQueryIndex + 1) % GPU_QUERY_FRAMES;
+}
+
+// Trace export ////
+// Complete ("X") events in microseconds since the oldest frame. CPU scopes
+// nest on one track by time, the fragment pass gets its own GPU track.
+static void WriteTraceEvent(std::ostringstream& json, const char* name, const char* category, int tid, Uint64 startNs, Uint64 endNs, Uint64 originNs){
+    json << ",\n{\"name\":\"" << name << "\",\"cat\":\"" << category << "\",\"ph\":\"X\""
+         << ",\"ts\":" << (double)(startNs - originNs) / 1000.0
+         << ",\"dur\":" << (double)(endNs - startNs) / 1000.0
+         << ",\"pid\":1,\"tid\":" << tid << "}";
+}
+
+bool ExportChromeTrace(const char* path){
+    std::vector<FrameRecord> frames(PROFILER_FRAMES);
+    int count = ReadFrameRecords(frames.data(), PROFILER_FRAMES);
+    if (count == 0) {
+        SDL_Log("No frames recorded yet");
+        return false;
+    }
+    Uint64 originNs = frames[0].startNs;
+
+    std::ostringstream json;
+    json.precision(3);
+    json << std::fixed;
+    json << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    json << "\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"SDL3 Shader\"}}";
+    json << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}}";
+    json << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}";
+    char frameName[32];
+    for (int i = 0; i < count; i++) {
+        const FrameRecord& frame = frames[i];
+        SDL_snprintf(frameName, sizeof(frameName), "frame %llu", (unsigned long long)frame.frame);
+        WriteTraceEvent(json, frameName, "frame", 1, frame.startNs, frame.endNs, originNs);
+        for (int s = 0; s < frame.scopeCount; s++) {
+            const ProfileScopeRecord& scope = frame.scopes[s];
+            WriteTraceEvent(json, scope.name, "cpu", 1, scope.startNs, scope.endNs, originNs);
+        }
+        if (frame.gpuEndNs > frame.gpuStartNs && frame.gpuStartNs >= originNs) {
+            WriteTraceEvent(json, "fragment pass", "gpu", 2, frame.gpuStartNs, frame.gpuEndNs, originNs);
+        }
+    }
+    json << "\n]}\n";
+
+    std::string text = json.str();
+    if (!SDL_SaveFile(path, text.data(), text.size())) {
+        SDL_Log("Failed to save file: %s", SDL_GetError());
+        return false;
+    }
+    SDL_Log("Saved %d frames to '%s'", count, path);
+    return true;
+}
+
+// HUD ////
+struct ScopeStats {
+    const char* name;
+    int depth;
+    double totalMs;
+    double maxMs;
+};
+
+static double ToMs(Uint64 ns){
+    return (double)ns / 1.0e6;
+}
+
+bool DrawProfilerWindow(bool* open){
+    static FrameRecord frames[HUD_FRAMES];
+    bool requestExport = false;
+    if (!ImGui::Begin("Profiler", open)) {
+        ImGui::End();
+        return false;
+    }
+    int count = ReadFrameRecords(frames, HUD_FRAMES);
+
+    float frameMs[HUD_FRAMES];
+    float gpuMs[HUD_FRAMES];
+    float frameMax = 0.0f;
+    double frameTotal = 0.0;
+    double gpuTotal = 0.0;
+    int gpuCount = 0;
+    std::vector<ScopeStats> scopes;
+    for (int i = 0; i < count; i++) {
+        const FrameRecord& frame = frames[i];
+        frameMs[i] = (float)ToMs(frame.endNs - frame.startNs);
+        gpuMs[i] = frame.gpuEndNs > frame.gpuStartNs ? (float)ToMs(frame.gpuEndNs - frame.gpuStartNs) : 0.0f;
+        frameMax = SDL_max(frameMax, frameMs[i]);
+        frameTotal += frameMs[i];
+        if (gpuMs[i] > 0.0f) {
+            gpuTotal += gpuMs[i];
+            gpuCount++;
+        }
+        // a scope that runs several times per frame (events) adds up
+        for (int s = 0; s < frame.scopeCount; s++) {
+            const ProfileScopeRecord& record = frame.scopes[s];
+            double ms = ToMs(record.endNs - record.startNs);
+            size_t k = 0;
+            while (k < scopes.size() && (scopes[k].name != record.name || scopes[k].depth != record.depth)) {
+                k++;
+            }
+            if (k == scopes.size()) {
+                scopes.push_back({ record.name, record.depth, 0.0, 0.0 });
+            }
+            scopes[k].totalMs += ms;
+            scopes[k].maxMs = SDL_max(scopes[k].maxMs, ms);
+        }
+    }
+
+    if (count > 0) {
+        char overlay[64];
+        SDL_snprintf(overlay, sizeof(overlay), "frame %.2f ms avg, %.2f ms max", frameTotal / count, frameMax);
+        ImGui::PlotLines("##frame", frameMs, count, 0, overlay, 0.0f, SDL_max(frameMax, 1.0f), ImVec2(-1.0f, 80.0f));
+        SDL_snprintf(overlay, sizeof(overlay), "fragment pass %.2f ms avg", gpuCount ? gpuTotal / gpuCount : 0.0);
+        ImGui::PlotLines("##gpu", gpuMs, count, 0, overlay, 0.0f, SDL_max(frameMax, 1.0f), ImVec2(-1.0f, 80.0f));
+    } else {
+        ImGui::TextDisabled("no frames yet");
+    }
+
+    if (ImGui::BeginTable("scopes", 3, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingStretchProp)) {
+        ImGui::TableSetupColumn("scope");
+        ImGui::TableSetupColumn("avg ms");
+        ImGui::TableSetupColumn("max ms");
+        ImGui::TableHeadersRow();
+        for (const ScopeStats& stats : scopes) {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::Indent((float)stats.depth * ImGui::GetStyle().IndentSpacing);
+            ImGui::TextUnformatted(stats.name);
+            ImGui::Unindent((float)stats.depth * ImGui::GetStyle().IndentSpacing);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", stats.totalMs / count);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", stats.maxMs);
+        }
+        ImGui::EndTable();
+    }
+    if (count > 0 && frames[count - 1].droppedScopes > 0) {
+        ImGui::TextDisabled("%d scopes over the per-frame limit", frames[count - 1].droppedScopes);
+    }
+
+    if (ImGui::Button("Export Trace...")) {
+        requestExport = true;
+    }
+    ImGui::SameLine();
+    ImGui::TextDisabled("last %d frames, chrome://tracing or ui.perfetto.dev", PROFILER_FRAMES);
+    ImGui::End();
+    return requestExport;
+}
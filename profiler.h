@@ -0,0 +1,60 @@
+#pragma once
+#include <SDL3/SDL.h>
+
+// Frame profiler: CPU scopes and the GPU time of the fragment pass for the
+// last PROFILER_FRAMES frames, shown in a HUD and exportable as a Chrome
+// trace_event file (chrome://tracing, ui.perfetto.dev).
+//
+// Recording happens on the main thread only and does nothing until
+// InitProfiler, so headless and export runs pay nothing. Finished frames are
+// published into a lock-free ring that any thread can read, dialog callbacks
+// included.
+static const int PROFILER_FRAMES = 1024;
+static const int PROFILER_MAX_SCOPES = 64;
+
+struct ProfileScopeRecord {
+    const char* name;   // string literal, never copied
+    Uint64 startNs;
+    Uint64 endNs;
+    int depth;
+};
+
+struct FrameRecord {
+    Uint64 frame = 0;
+    Uint64 startNs = 0;         // SDL_GetTicksNS clock
+    Uint64 endNs = 0;
+    Uint64 gpuStartNs = 0;      // fragment pass mapped onto the CPU clock, 0 until its queries are read
+    Uint64 gpuEndNs = 0;
+    int scopeCount = 0;
+    int droppedScopes = 0;      // past PROFILER_MAX_SCOPES
+    ProfileScopeRecord scopes[PROFILER_MAX_SCOPES];
+};
+
+// Needs the GL context current.
+void InitProfiler();
+void ShutdownProfiler();
+
+// Publishes the running frame and starts the next one. Events handled
+// between two calls belong to the frame that follows them.
+void EndProfileFrame();
+
+void BeginProfileScope(const char* name);
+void EndProfileScope();
+
+struct ProfileScope {
+    explicit ProfileScope(const char* name){ BeginProfileScope(name); }
+    ~ProfileScope(){ EndProfileScope(); }
+};
+
+// Timestamp queries around the fragment pass, read back frames later without waiting.
+void BeginGpuPass();
+void EndGpuPass();
+
+// Copies up to maxFrames of the newest finished frames, oldest first.
+int ReadFrameRecords(FrameRecord* frames, int maxFrames);
+
+// Every frame still in the ring as Chrome trace_event JSON.
+bool ExportChromeTrace(const char* path);
+
+// Frame-time graph and per-scope breakdown. Returns true when "Export Trace..." was clicked.
+bool DrawProfilerWindow(bool* open);
@@ -0,0 +1,246 @@
+#include "program_cache.h"
+#include <cstring>
+#include <sstream>
+#include <unordered_map>
+#include <vector>
+
+struct CacheEntry {
+    Uint64 size = 0;
+    Uint64 lastUse = 0;
+};
+
+// Stored in front of every binary.
+struct CacheHeader {
+    char magic[4];
+    Uint32 version;
+    Uint64 key;
+    Uint32 format;
+    Uint32 length;
+};
+
+static const char kCacheMagic[4] = { 'S', 'H', 'B', 'N' };
+static const Uint32 kCacheVersion = 1;
+
+static bool enabled = false;
+static std::string cacheDir;
+static Uint64 cacheMaxBytes = 0;
+static Uint64 cacheBytes = 0;
+static Uint64 useCounter = 0;
+static Uint64 driverHash = 0;
+static std::unordered_map<Uint64, CacheEntry> entries;
+
+// FNV-1a, 64 bit
+static Uint64 HashBytes(Uint64 hash, const void* data, size_t size){
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static Uint64 HashString(Uint64 hash, const char* s){
+    if (!s) {
+        s = "";
+    }
+    return HashBytes(hash, s, strlen(s) + 1); // include the terminator as a separator
+}
+
+static std::string EntryPath(Uint64 key){
+    char name[32];
+    SDL_snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+    return cacheDir + name;
+}
+
+static std::string IndexPath(){
+    return cacheDir + "index.txt";
+}
+
+static void SaveIndex(){
+    std::ostringstream index;
+    for (const auto& it : entries) {
+        index << std::hex << it.first << std::dec << " " << it.second.lastUse << "\n";
+    }
+    std::string text = index.str();
+    SDL_SaveFile(IndexPath().c_str(), text.data(), text.size());
+}
+
+static void RemoveEntry(Uint64 key){
+    auto it = entries.find(key);
+    if (it == entries.end()) {
+        return;
+    }
+    cacheBytes -= it->second.size;
+    entries.erase(it);
+    SDL_RemovePath(EntryPath(key).c_str());
+}
+
+static void EvictToLimit(){
+    while (cacheBytes > cacheMaxBytes && !entries.empty()) {
+        auto oldest = entries.begin();
+        for (auto it = entries.begin(); it != entries.end(); ++it) {
+            if (it->second.lastUse < oldest->second.lastUse) {
+                oldest = it;
+            }
+        }
+        RemoveEntry(oldest->first);
+    }
+}
+
+static SDL_EnumerationResult SDLCALL CollectEntry(void* userdata, const char* dirname, const char* fname){
+    unsigned long long key = 0;
+    char ext[8] = {0};
+    if (SDL_sscanf(fname, "%16llx.%3s", &key, ext) != 2 || SDL_strcmp(ext, "bin") != 0) {
+        return SDL_ENUM_CONTINUE;
+    }
+    SDL_PathInfo info;
+    if (SDL_GetPathInfo((std::string(dirname) + fname).c_str(), &info) && info.type == SDL_PATHTYPE_FILE) {
+        CacheEntry entry;
+        entry.size = info.size;
+        entries[(Uint64)key] = entry;
+        cacheBytes += info.size;
+    }
+    return SDL_ENUM_CONTINUE;
+}
+
+bool InitProgramCache(const std::string& directory, Uint64 maxBytes){
+    enabled = false;
+    entries.clear();
+    cacheBytes = 0;
+    if (!GLAD_GL_ARB_get_program_binary) {
+        SDL_Log("Program cache disabled: ARB_get_program_binary not supported");
+        return false;
+    }
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    if (formats == 0) {
+        SDL_Log("Program cache disabled: the driver exposes no program binary formats");
+        return false;
+    }
+    cacheDir = directory;
+    if (!cacheDir.empty() && cacheDir.back() != '/' && cacheDir.back() != '\\') {
+        cacheDir += '/';
+    }
+    if (!SDL_CreateDirectory(cacheDir.c_str())) {
+        SDL_Log("Program cache disabled: %s", SDL_GetError());
+        return false;
+    }
+    cacheMaxBytes = maxBytes;
+
+    driverHash = HashString(14695981039346656037ull, (const char*)glGetString(GL_VENDOR));
+    driverHash = HashString(driverHash, (const char*)glGetString(GL_RENDERER));
+    driverHash = HashString(driverHash, (const char*)glGetString(GL_VERSION));
+
+    SDL_EnumerateDirectory(cacheDir.c_str(), CollectEntry, NULL);
+
+    // recency survives restarts through the index; unknown files count as oldest
+    size_t indexSize = 0;
+    char* index = (char*)SDL_LoadFile(IndexPath().c_str(), &indexSize);
+    if (index) {
+        std::istringstream lines(std::string(index, indexSize));
+        SDL_free(index);
+        Uint64 key = 0, lastUse = 0;
+        while (lines >> std::hex >> key >> std::dec >> lastUse) {
+            auto it = entries.find(key);
+            if (it != entries.end()) {
+                it->second.lastUse = lastUse;
+                useCounter = SDL_max(useCounter, lastUse);
+            }
+        }
+    }
+    enabled = true;
+    EvictToLimit();
+    return true;
+}
+
+bool IsProgramCacheEnabled(){
+    return enabled;
+}
+
+Uint64 ProgramCacheKey(const std::string& vertexSource, const std::string& fragmentSource){
+    Uint64 hash = HashBytes(driverHash, vertexSource.data(), vertexSource.size());
+    hash = HashBytes(hash, "\0", 1);
+    return HashBytes(hash, fragmentSource.data(), fragmentSource.size());
+}
+
+GLuint LoadCachedProgram(Uint64 key){
+    if (!enabled || entries.find(key) == entries.end()) {
+        return 0;
+    }
+    size_t fileSize = 0;
+    unsigned char* data = (unsigned char*)SDL_LoadFile(EntryPath(key).c_str(), &fileSize);
+    if (!data) {
+        RemoveEntry(key);
+        return 0;
+    }
+    CacheHeader header;
+    bool valid = fileSize >= sizeof(header);
+    if (valid) {
+        memcpy(&header, data, sizeof(header));
+        valid = memcmp(header.magic, kCacheMagic, sizeof(kCacheMagic)) == 0
+            && header.version == kCacheVersion
+            && header.key == key
+            && sizeof(header) + header.length == fileSize;
+    }
+
+    GLuint program = 0;
+    if (valid) {
+        program = glCreateProgram();
+        glProgramBinary(program, header.format, data + sizeof(header), (GLsizei)header.length);
+        GLint linked = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (!linked) {
+            // driver update or a binary it doesn't like: recompile from source
+            glDeleteProgram(program);
+            program = 0;
+        }
+    }
+    SDL_free(data);
+
+    if (program == 0) {
+        RemoveEntry(key);
+        SaveIndex();
+        return 0;
+    }
+    entries[key].lastUse = ++useCounter;
+    SaveIndex();
+    return program;
+}
+
+void StoreCachedProgram(Uint64 key, GLuint program){
+    if (!enabled || program == 0) {
+        return;
+    }
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return;
+    }
+
+    CacheHeader header;
+    memcpy(header.magic, kCacheMagic, sizeof(kCacheMagic));
+    header.version = kCacheVersion;
+    header.key = key;
+    std::vector<unsigned char> file(sizeof(header) + length);
+    GLenum format = 0;
+    GLsizei written = 0;
+    glGetProgramBinary(program, length, &written, &format, file.data() + sizeof(header));
+    if (written <= 0) {
+        return;
+    }
+    header.format = format;
+    header.length = (Uint32)written;
+    memcpy(file.data(), &header, sizeof(header));
+    file.resize(sizeof(header) + written);
+
+    if (!SDL_SaveFile(EntryPath(key).c_str(), file.data(), file.size())) {
+        SDL_Log("Failed to save file: %s", SDL_GetError());
+        return;
+    }
+    CacheEntry& entry = entries[key];
+    cacheBytes = cacheBytes - entry.size + file.size();
+    entry.size = file.size();
+    entry.lastUse = ++useCounter;
+    EvictToLimit();
+    SaveIndex();
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include <glad/gl.h>
+#include <SDL3/SDL.h>
+#include <string>
+
+// On-disk cache of linked program binaries (ARB_get_program_binary).
+// Entries are keyed by a hash of both sources and the GL vendor, renderer and
+// version strings, and evicted least-recently-used once the directory grows
+// past `maxBytes`. Main thread only, with the window context current.
+bool InitProgramCache(const std::string& directory, Uint64 maxBytes);
+bool IsProgramCacheEnabled();
+
+Uint64 ProgramCacheKey(const std::string& vertexSource, const std::string& fragmentSource);
+
+// Returns a linked program, or 0 on a miss or when the driver rejects the
+// stored binary (the entry is dropped and the caller compiles as usual).
+GLuint LoadCachedProgram(Uint64 key);
+void StoreCachedProgram(Uint64 key, GLuint program);
@@ -0,0 +1,115 @@
+#include "render_scale.h"
+#include <math.h>
+
+// Controller tuning: hold inside the deadband, otherwise move a quarter of the
+// way towards the scale that would hit the target (cost ~ scale^2).
+static const float kDeadbandLow = 0.8f;
+static const float kDeadbandHigh = 1.0f;
+static const float kSmoothing = 0.25f;
+
+void InitRenderScale(RenderScale* rs){
+    glGenQueries(RenderScale::QUERY_COUNT, rs->queries);
+}
+
+void DestroyRenderScale(RenderScale* rs){
+    glDeleteQueries(RenderScale::QUERY_COUNT, rs->queries);
+    glDeleteFramebuffers(1, &rs->fbo);
+    glDeleteTextures(1, &rs->color);
+    rs->fbo = 0;
+    rs->color = 0;
+    rs->width = 0;
+    rs->height = 0;
+}
+
+static void ResizeTarget(RenderScale* rs, int width, int height){
+    if (rs->fbo != 0 && rs->width == width && rs->height == height) {
+        return;
+    }
+    if (rs->fbo == 0) {
+        glGenFramebuffers(1, &rs->fbo);
+        glGenTextures(1, &rs->color);
+    }
+    glBindTexture(GL_TEXTURE_2D, rs->color);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, rs->fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, rs->color, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    rs->width = width;
+    rs->height = height;
+}
+
+// Reads every finished query without waiting; gpuMs ends up at the newest one.
+static void CollectQueries(RenderScale* rs){
+    for (int i = 1; i <= RenderScale::QUERY_COUNT; i++) {
+        int index = (rs->queryIndex + i) % RenderScale::QUERY_COUNT; // oldest first
+        if (!rs->queryPending[index]) {
+            continue;
+        }
+        GLint available = GL_FALSE;
+        glGetQueryObjectiv(rs->queries[index], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) {
+            break;
+        }
+        GLuint64 ns = 0;
+        glGetQueryObjectui64v(rs->queries[index], GL_QUERY_RESULT, &ns);
+        rs->queryPending[index] = false;
+        rs->gpuMs = (float)((double)ns / 1.0e6);
+    }
+}
+
+static void UpdateController(RenderScale* rs){
+    if (!rs->dynamic || rs->gpuMs <= 0.0f) {
+        return;
+    }
+    float ratio = rs->gpuMs / rs->targetMs;
+    if (ratio >= kDeadbandLow && ratio <= kDeadbandHigh) {
+        return;
+    }
+    float wanted = rs->scale * sqrtf(1.0f / ratio);
+    float scale = rs->scale + (wanted - rs->scale) * kSmoothing;
+    rs->scale = fminf(1.0f, fmaxf(rs->minScale, scale));
+}
+
+void BeginScaledPass(RenderScale* rs, int windowWidth, int windowHeight, int* renderWidth, int* renderHeight){
+    CollectQueries(rs);
+    UpdateController(rs);
+
+    rs->offscreen = rs->scale < 1.0f;
+    if (!rs->offscreen) {
+        // full resolution: draw straight into the window, no blit
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        *renderWidth = windowWidth;
+        *renderHeight = windowHeight;
+    } else {
+        ResizeTarget(rs, windowWidth, windowHeight);
+        glBindFramebuffer(GL_FRAMEBUFFER, rs->fbo);
+        *renderWidth = (int)fmaxf(1.0f, floorf(windowWidth * rs->scale));
+        *renderHeight = (int)fmaxf(1.0f, floorf(windowHeight * rs->scale));
+    }
+    glViewport(0, 0, *renderWidth, *renderHeight);
+
+    if (!rs->queryPending[rs->queryIndex]) {
+        glBeginQuery(GL_TIME_ELAPSED, rs->queries[rs->queryIndex]);
+    }
+}
+
+void EndScaledPass(RenderScale* rs, int windowWidth, int windowHeight, int renderWidth, int renderHeight){
+    if (!rs->queryPending[rs->queryIndex]) {
+        glEndQuery(GL_TIME_ELAPSED);
+        rs->queryPending[rs->queryIndex] = true;
+        rs->queryIndex = (rs->queryIndex + 1) % RenderScale::QUERY_COUNT;
+    }
+
+    if (rs->offscreen) {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, rs->fbo);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+        glBlitFramebuffer(0, 0, renderWidth, renderHeight, 0, 0, windowWidth, windowHeight,
+                          GL_COLOR_BUFFER_BIT, GL_LINEAR);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, windowWidth, windowHeight);
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <glad/gl.h>
+
+// Renders the fragment pass into an offscreen target at a fraction of the
+// window size and upscales it into the default framebuffer. With `dynamic`
+// set, the fraction follows the GPU time of the pass towards `targetMs`.
+//
+// The target is allocated at full window size and only the lower-left
+// scale*size rectangle is drawn, so scale changes never reallocate.
+struct RenderScale {
+    bool dynamic = true;
+    float scale = 1.0f;
+    float minScale = 0.25f;
+    float targetMs = 8.0f;
+    float gpuMs = 0.0f;         // latest measured pass time
+    bool offscreen = false;     // this frame draws into fbo
+
+    GLuint fbo = 0;
+    GLuint color = 0;
+    int width = 0;
+    int height = 0;
+
+    static const int QUERY_COUNT = 4;
+    GLuint queries[QUERY_COUNT] = {};
+    bool queryPending[QUERY_COUNT] = {};
+    int queryIndex = 0;
+};
+
+void InitRenderScale(RenderScale* rs);
+void DestroyRenderScale(RenderScale* rs);
+
+// Binds the framebuffer to draw into and returns the size to render at.
+void BeginScaledPass(RenderScale* rs, int windowWidth, int windowHeight, int* renderWidth, int* renderHeight);
+// Upscales into the default framebuffer (if offscreen) and updates the controller.
+void EndScaledPass(RenderScale* rs, int windowWidth, int windowHeight, int renderWidth, int renderHeight);
@@ -0,0 +1,350 @@
+#include "renderer.h"
+#include "profiler.h"
+#include <iostream>
+#include <cstring>
+#include <algorithm>
+
+static const char* kBuiltinNames[Uniform_COUNT] = {
+    "u_time",
+    "u_resolution",
+    "u_mouse",
+    "iResolution",
+    "iTime",
+    "iTimeDelta",
+    "iFrameRate",
+    "iFrame",
+    "iMouse",
+    "iDate",
+    "iSampleRate",
+    "iChannelTime",
+    "iChannelResolution",
+    "iChannel0",
+    "iChannel1",
+    "iChannel2",
+    "iChannel3",
+};
+
+static const float kSampleRate = 44100.0f;
+
+// OpenGL Helpers ////
+bool CheckShaderCompilation(GLuint shader, const char* type, std::string* log) {
+    GLint success;
+    GLchar infoLog[1024];
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (!success && log) {
+        glGetShaderInfoLog(shader, 1024, NULL, infoLog);
+        *log += std::string("Shader Compilation Error (") + type + "): " + infoLog + "\n";
+    }
+    return success == GL_TRUE;
+}
+
+bool CheckShaderLinking(GLuint program, std::string* log) {
+    GLint success;
+    GLchar infoLog[1024];
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success && log) {
+        glGetProgramInfoLog(program, 1024, NULL, infoLog);
+        *log += std::string("Shader Linking Error: ") + infoLog + "\n";
+    }
+    return success == GL_TRUE;
+}
+
+ProgramBuild StartProgramBuild(const std::string& vertexSource, const std::string& fragmentSource){
+    const char* vsrc = vertexSource.c_str();
+    const char* fsrc = fragmentSource.c_str();
+    ProgramBuild build;
+    build.vertexShader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(build.vertexShader,1,&vsrc,NULL);
+    glCompileShader(build.vertexShader);
+
+    build.fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(build.fragmentShader,1,&fsrc,NULL);
+    glCompileShader(build.fragmentShader);
+
+    build.program = glCreateProgram();
+    if (GLAD_GL_ARB_get_program_binary) {
+        glProgramParameteri(build.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+    glAttachShader(build.program, build.vertexShader);
+    glAttachShader(build.program, build.fragmentShader);
+    glLinkProgram(build.program);
+    return build;
+}
+
+GLuint FinishProgramBuild(ProgramBuild* build, std::string* log){
+    bool ok = CheckShaderCompilation(build->vertexShader, "VERTEX", log);
+    ok = CheckShaderCompilation(build->fragmentShader, "FRAGMENT", log) && ok;
+    ok = CheckShaderLinking(build->program, log) && ok;
+
+    glDetachShader(build->program, build->vertexShader);
+    glDetachShader(build->program, build->fragmentShader);
+    glDeleteShader(build->vertexShader);
+    glDeleteShader(build->fragmentShader);
+
+    GLuint program = build->program;
+    if (!ok) {
+        glDeleteProgram(program);
+        program = 0;
+    }
+    *build = ProgramBuild();
+    return program;
+}
+
+GLuint CompileProgram(const std::string& vertexSource, const std::string& fragmentSource, std::string* log){
+    ProgramBuild build = StartProgramBuild(vertexSource, fragmentSource);
+    std::string errors;
+    GLuint program = FinishProgramBuild(&build, &errors);
+    if (log) {
+        *log += errors;
+    } else if (!errors.empty()) {
+        std::cerr << errors;
+    }
+    return program;
+}
+
+#ifdef SHADER_GL_DEBUG
+static void GLAD_API_PTR DebugMessageCallback(GLenum source, GLenum type, GLuint id, GLenum severity,
+                                              GLsizei length, const GLchar* message, const void* userParam){
+    const char* kind = (type == GL_DEBUG_TYPE_ERROR) ? "Error" : "Message";
+    std::cerr << "OpenGL " << kind << " (" << id << "): " << message << std::endl;
+}
+#endif
+
+void EnableGLDebugOutput(){
+#ifdef SHADER_GL_DEBUG
+    if (!GLAD_GL_KHR_debug) {
+        std::cerr << "GL_KHR_debug not available, GL errors will not be reported" << std::endl;
+        return;
+    }
+    glEnable(GL_DEBUG_OUTPUT);
+    glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS); // report at the offending call
+    glDebugMessageCallback(DebugMessageCallback, NULL);
+    glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DEBUG_SEVERITY_NOTIFICATION, 0, NULL, GL_FALSE);
+#endif
+}
+
+// Uniform reflection ////
+void ReflectProgram(GLuint program, ProgramReflection* reflection){
+    *reflection = ProgramReflection();
+    if (program == 0) {
+        return;
+    }
+
+    GLint count = 0, maxLength = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    std::string name(maxLength > 0 ? maxLength : 1, '\0');
+    for (GLint i = 0; i < count; i++) {
+        GLuint index = (GLuint)i;
+        GLint blockIndex = -1;
+        glGetActiveUniformsiv(program, 1, &index, GL_UNIFORM_BLOCK_INDEX, &blockIndex);
+        if (blockIndex != -1) {
+            continue; // block members are fed through their buffer
+        }
+
+        UniformInfo info;
+        GLsizei length = 0;
+        glGetActiveUniform(program, index, (GLsizei)name.size(), &length, &info.size, &info.type, &name[0]);
+        info.name.assign(name.data(), length);
+        info.location = glGetUniformLocation(program, info.name.c_str());
+        size_t bracket = info.name.find('[');
+        if (bracket != std::string::npos) {
+            info.name.resize(bracket);
+        }
+
+        for (int b = 0; b < Uniform_COUNT; b++) {
+            if (info.name == kBuiltinNames[b]) {
+                reflection->builtins[b] = info;
+            }
+        }
+        reflection->uniforms.push_back(info);
+    }
+
+    // sampler units are program state, set them once here
+    GLint previous = 0;
+    glGetIntegerv(GL_CURRENT_PROGRAM, &previous);
+    glUseProgram(program);
+    for (int c = 0; c < 4; c++) {
+        GLint location = reflection->builtins[Uniform_iChannel0 + c].location;
+        if (location >= 0) {
+            glUniform1i(location, c);
+        }
+    }
+    glUseProgram((GLuint)previous);
+
+    GLuint block = glGetUniformBlockIndex(program, "ShaderToy");
+    if (block != GL_INVALID_INDEX) {
+        GLint blockSize = 0;
+        glGetActiveUniformBlockiv(program, block, GL_UNIFORM_BLOCK_DATA_SIZE, &blockSize);
+        if (blockSize == (GLint)sizeof(ShadertoyBlock)) {
+            glUniformBlockBinding(program, block, kShadertoyBlockBinding);
+            reflection->usesShadertoyBlock = true;
+        } else {
+            std::cerr << "ShaderToy uniform block is " << blockSize << " bytes, expected "
+                      << sizeof(ShadertoyBlock) << " (std140); ignoring it" << std::endl;
+        }
+    }
+}
+
+bool ProgramUsesTime(const ProgramReflection& reflection){
+    static const BuiltinUniform timeUniforms[] = {
+        Uniform_u_time, Uniform_iTime, Uniform_iTimeDelta, Uniform_iFrameRate, Uniform_iFrame, Uniform_iDate
+    };
+    for (BuiltinUniform u : timeUniforms) {
+        if (reflection.builtins[u].location >= 0) {
+            return true;
+        }
+    }
+    return reflection.usesShadertoyBlock; // the block always carries iTime
+}
+
+// Uploads up to four components, narrowed to whatever type the shader declared.
+static void SetUniform(const UniformInfo& info, const float* v){
+    if (info.location < 0) {
+        return;
+    }
+    switch (info.type) {
+        case GL_FLOAT:      glUniform1f(info.location, v[0]); break;
+        case GL_FLOAT_VEC2: glUniform2f(info.location, v[0], v[1]); break;
+        case GL_FLOAT_VEC3: glUniform3f(info.location, v[0], v[1], v[2]); break;
+        case GL_FLOAT_VEC4: glUniform4f(info.location, v[0], v[1], v[2], v[3]); break;
+        case GL_INT:        glUniform1i(info.location, (GLint)v[0]); break;
+        default: break;
+    }
+}
+
+// Counters stay exact past 2^24 unless the shader itself declared a float.
+static void SetUniformInt(const UniformInfo& info, int v){
+    if (info.location < 0) {
+        return;
+    }
+    switch (info.type) {
+        case GL_INT:        glUniform1i(info.location, v); break;
+        case GL_FLOAT:      glUniform1f(info.location, (float)v); break;
+        default: break;
+    }
+}
+
+// Fullscreen quad ////
+void CreateFullscreenQuad(ShaderQuad* quad){
+    float vertices[] = {
+        // Pos      // UV (Texture Coords)
+        -1.0f,  1.0f,  0.0f, 1.0f, // Top-Left
+        1.0f,  1.0f,  1.0f, 1.0f, // Top-Right
+        1.0f, -1.0f,  1.0f, 0.0f, // Bottom-Right
+
+        -1.0f,  1.0f,  0.0f, 1.0f, // Top-Left
+        1.0f, -1.0f,  1.0f, 0.0f, // Bottom-Right
+        -1.0f, -1.0f,  0.0f, 0.0f  // Bottom-Left
+    };
+
+    glGenVertexArrays(1, &quad->vao);
+    glGenBuffers(1, &quad->vbo);
+
+    glBindVertexArray(quad->vao);
+    glBindBuffer(GL_ARRAY_BUFFER, quad->vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+
+    glGenBuffers(1, &quad->ubo);
+    glBindBuffer(GL_UNIFORM_BUFFER, quad->ubo);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(ShadertoyBlock), NULL, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, kShadertoyBlockBinding, quad->ubo);
+}
+
+void DestroyFullscreenQuad(ShaderQuad* quad){
+    glDeleteVertexArrays(1, &quad->vao);
+    glDeleteBuffers(1, &quad->vbo);
+    glDeleteBuffers(1, &quad->ubo);
+    *quad = ShaderQuad();
+}
+
+void DrawShaderQuad(GLuint program, const ProgramReflection& reflection, const ShaderQuad& quad, const ShaderInputs& in){
+    float w = in.width;
+    float h = in.height;
+
+    // Flip Y to match Shadertoy
+    float currentY = h - in.mouseY;
+    float lastClickY = h - in.clickY;
+    float mouse[4];
+    if (in.mouseDown) {
+        // While button is down: xy = current pos, zw = start pos
+        mouse[0] = in.mouseX; mouse[1] = currentY; mouse[2] = in.clickX; mouse[3] = lastClickY;
+    } else {
+        // Shadertoy standard: zw becomes negative (or remains last click) when up
+        mouse[0] = in.mouseX; mouse[1] = currentY; mouse[2] = -in.clickX; mouse[3] = -lastClickY;
+    }
+
+    BeginProfileScope("uniform upload");
+    glUseProgram(program);
+
+    const UniformInfo* u = reflection.builtins;
+    float time[1]       = { in.time };
+    float resolution[3] = { w, h, 1.0f };
+    float rawMouse[2]   = { in.mouseX, in.mouseY };
+    float timeDelta[1]  = { in.timeDelta };
+    float frameRate[1]  = { in.frameRate };
+    float sampleRate[1] = { kSampleRate };
+    SetUniform(u[Uniform_u_time], time);
+    SetUniform(u[Uniform_u_resolution], resolution);
+    SetUniform(u[Uniform_u_mouse], rawMouse);
+
+    // shadertoy uniforms, either loose or through the std140 ShaderToy block
+    SetUniform(u[Uniform_iResolution], resolution);
+    SetUniform(u[Uniform_iTime], time);
+    SetUniform(u[Uniform_iTimeDelta], timeDelta);
+    SetUniform(u[Uniform_iFrameRate], frameRate);
+    SetUniformInt(u[Uniform_iFrame], in.frame);
+    SetUniform(u[Uniform_iMouse], mouse);
+    SetUniform(u[Uniform_iDate], in.date);
+    SetUniform(u[Uniform_iSampleRate], sampleRate);
+
+    // uniform float     iChannelTime[4];       // channel playback time (in seconds)
+    // uniform vec3      iChannelResolution[4]; // channel resolution (in pixels)
+    // uniform sampler2D iChannel0..3;          // input channel
+    if (u[Uniform_iChannelTime].location >= 0) {
+        float channelTime[4] = { in.time, in.time, in.time, in.time };
+        glUniform1fv(u[Uniform_iChannelTime].location, std::min(u[Uniform_iChannelTime].size, 4), channelTime);
+    }
+    if (u[Uniform_iChannelResolution].location >= 0) {
+        glUniform3fv(u[Uniform_iChannelResolution].location, std::min(u[Uniform_iChannelResolution].size, 4), &in.channelResolution[0][0]);
+    }
+    for (int c = 0; c < 4; c++) {
+        GLint location = u[Uniform_iChannel0 + c].location;
+        if (location < 0) {
+            continue;
+        }
+        if (in.channelHandles[c] != 0) {
+            glUniformHandleui64ARB(location, in.channelHandles[c]);
+        } else {
+            glUniform1i(location, c); // may have held a handle last frame
+            glActiveTexture(GL_TEXTURE0 + c);
+            glBindTexture(GL_TEXTURE_2D, in.channels[c]);
+        }
+    }
+    glActiveTexture(GL_TEXTURE0);
+
+    if (reflection.usesShadertoyBlock) {
+        ShadertoyBlock block;
+        memcpy(block.iResolution, resolution, sizeof(block.iResolution));
+        block.iTime = in.time;
+        memcpy(block.iMouse, mouse, sizeof(block.iMouse));
+        memcpy(block.iDate, in.date, sizeof(block.iDate));
+        block.iTimeDelta = in.timeDelta;
+        block.iFrameRate = in.frameRate;
+        block.iFrame = in.frame;
+        block.iSampleRate = kSampleRate;
+        glBindBuffer(GL_UNIFORM_BUFFER, quad.ubo);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(block), &block);
+    }
+    EndProfileScope();
+
+    ProfileScope draw("quad draw");
+    glBindVertexArray(quad.vao);
+    glDrawArrays(GL_TRIANGLES, 0, 6);
+}
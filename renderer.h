@@ -0,0 +1,126 @@
+#pragma once
+#include <glad/gl.h>
+#include <string>
+#include <vector>
+
+// Values fed to the fragment shader for one frame.
+// Mouse coordinates are in window space (y down), like SDL_GetMouseState.
+struct ShaderInputs {
+    float time = 0.0f;
+    float timeDelta = 0.0f;
+    float frameRate = 0.0f;
+    int frame = 0;
+    float width = 0.0f;
+    float height = 0.0f;
+    float mouseX = 0.0f;
+    float mouseY = 0.0f;
+    float clickX = 0.0f;
+    float clickY = 0.0f;
+    bool mouseDown = false;
+    float date[4] = {0.0f, 0.0f, 0.0f, 0.0f}; // year, month (0-11), day, seconds since midnight
+    GLuint channels[4] = {0, 0, 0, 0};        // GL_TEXTURE_2D bound to iChannel0..3
+    GLuint64 channelHandles[4] = {0, 0, 0, 0}; // bindless handles, used instead of binding when set
+    float channelResolution[4][3] = {};
+};
+
+// Uniform reflection ////
+enum BuiltinUniform {
+    Uniform_u_time,
+    Uniform_u_resolution,
+    Uniform_u_mouse,
+    Uniform_iResolution,
+    Uniform_iTime,
+    Uniform_iTimeDelta,
+    Uniform_iFrameRate,
+    Uniform_iFrame,
+    Uniform_iMouse,
+    Uniform_iDate,
+    Uniform_iSampleRate,
+    Uniform_iChannelTime,
+    Uniform_iChannelResolution,
+    Uniform_iChannel0,
+    Uniform_iChannel1,
+    Uniform_iChannel2,
+    Uniform_iChannel3,
+    Uniform_COUNT
+};
+
+struct UniformInfo {
+    std::string name;   // array uniforms without the trailing "[0]"
+    GLint location = -1;
+    GLenum type = 0;
+    GLint size = 0;
+};
+
+// Built once per linked program so the frame loop never asks the driver for
+// locations again. Built-ins the shader doesn't declare stay at location -1
+// and are skipped.
+struct ProgramReflection {
+    std::vector<UniformInfo> uniforms;
+    UniformInfo builtins[Uniform_COUNT];
+    bool usesShadertoyBlock = false; // `layout(std140) uniform ShaderToy {...}` is active
+};
+
+// Mirrors the std140 layout of the ShaderToy uniform block:
+//   layout(std140) uniform ShaderToy {
+//       vec3  iResolution; float iTime;
+//       vec4  iMouse;
+//       vec4  iDate;
+//       float iTimeDelta;  float iFrameRate; int iFrame; float iSampleRate;
+//   };
+struct ShadertoyBlock {
+    float iResolution[3];
+    float iTime;
+    float iMouse[4];
+    float iDate[4];
+    float iTimeDelta;
+    float iFrameRate;
+    GLint iFrame;
+    float iSampleRate;
+};
+static_assert(sizeof(ShadertoyBlock) == 64, "ShadertoyBlock must match the std140 layout");
+
+static const GLuint kShadertoyBlockBinding = 0;
+
+// Also points the iChannelN samplers at texture unit N.
+void ReflectProgram(GLuint program, ProgramReflection* reflection);
+// True when the output can change without input (time or frame driven).
+bool ProgramUsesTime(const ProgramReflection& reflection);
+
+// OpenGL Helpers ////
+// Both append the info log to `log` (when given) and return the status.
+bool CheckShaderCompilation(GLuint shader, const char* type, std::string* log);
+bool CheckShaderLinking(GLuint program, std::string* log);
+
+// A build split in two so callers can poll GL_COMPLETION_STATUS_KHR in
+// between instead of blocking on the status queries.
+struct ProgramBuild {
+    GLuint vertexShader = 0;
+    GLuint fragmentShader = 0;
+    GLuint program = 0;
+};
+ProgramBuild StartProgramBuild(const std::string& vertexSource, const std::string& fragmentSource);
+// Returns the linked program, or 0 (and deletes it) when compiling or linking failed.
+GLuint FinishProgramBuild(ProgramBuild* build, std::string* log);
+
+// Blocking Start + Finish. Errors go to `log`, or std::cerr when log is NULL.
+GLuint CompileProgram(const std::string& vertexSource, const std::string& fragmentSource, std::string* log = NULL);
+
+// Routes driver errors through a KHR_debug callback. Compiled to a no-op
+// unless SHADER_GL_DEBUG is defined (Debug builds), so release frames never
+// pay for error checks.
+void EnableGLDebugOutput();
+
+// Fullscreen quad ////
+struct ShaderQuad {
+    GLuint vao = 0;
+    GLuint vbo = 0;
+    GLuint ubo = 0; // backs the ShaderToy block
+};
+
+void CreateFullscreenQuad(ShaderQuad* quad);
+void DestroyFullscreenQuad(ShaderQuad* quad);
+
+// Uploads the built-in uniforms and draws the quad into the bound framebuffer.
+// The caller owns viewport, clear and blend state.
+void DrawShaderQuad(GLuint program, const ProgramReflection& reflection, const ShaderQuad& quad, const ShaderInputs& in);
@@ -0,0 +1,309 @@
+#include "shader_compiler.h"
+#include "renderer.h"
+#include "program_cache.h"
+#include "shader_preprocessor.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+enum CompileMode {
+    Compile_Sync,
+    Compile_Parallel,   // GL_KHR_parallel_shader_compile, polled on the main thread
+    Compile_Worker      // blocking build on a thread with a shared context
+};
+
+struct CompileJob {
+    int slot = 0;
+    unsigned generation = 0;
+    Uint64 cacheKey = 0;
+    std::string vertexSource;
+    std::string fragmentSource;
+};
+
+struct CompileResult {
+    int slot = 0;
+    unsigned generation = 0;
+    Uint64 cacheKey = 0;
+    bool fromCache = false;
+    GLuint program = 0;
+    std::string log;
+};
+
+static CompileMode mode = Compile_Sync;
+static unsigned submitted[SHADER_SLOT_COUNT] = {};  // generation of the newest submit
+static unsigned completed[SHADER_SLOT_COUNT] = {};  // generation of the newest result handed back
+static std::vector<std::string> logs;
+static SourceMap sourceMaps[SHADER_SLOT_COUNT];     // of the newest submit, the only one whose log is kept
+
+// Compile_Parallel
+struct ParallelBuild {
+    ProgramBuild build;
+    unsigned generation = 0;
+    Uint64 cacheKey = 0;
+};
+static ParallelBuild parallelBuilds[SHADER_SLOT_COUNT];
+
+// Compile_Worker; Compile_Sync and cache hits reuse the result queue.
+// The worker gets a hidden window of its own: EGL (Wayland) refuses to make
+// one surface current on two threads, and the main thread holds the window's.
+static SDL_Window* workerWindow = NULL;
+static SDL_GLContext workerContext = NULL;
+static std::thread worker;
+static std::mutex compileMutex;
+static std::condition_variable compileWake;
+static bool workerQuit = false;
+static int workerStarted = 0;       // 1 once the context is current, -1 if that failed
+static int jobCount = 0;
+static bool hasJob[SHADER_SLOT_COUNT] = {};
+static CompileJob pendingJobs[SHADER_SLOT_COUNT];   // only the newest job per slot is worth building
+static std::deque<CompileResult> results;
+
+static void WorkerMain(){
+    bool current = SDL_GL_MakeCurrent(workerWindow, workerContext);
+    if (!current) {
+        SDL_Log("Couldn't make the shader compile context current: %s", SDL_GetError());
+    }
+    std::unique_lock<std::mutex> lock(compileMutex);
+    workerStarted = current ? 1 : -1;
+    compileWake.notify_all();
+    if (!current) {
+        return;
+    }
+    for (;;) {
+        compileWake.wait(lock, []{ return workerQuit || jobCount > 0; });
+        if (workerQuit) {
+            break;
+        }
+        CompileJob job;
+        for (int slot = 0; slot < SHADER_SLOT_COUNT; slot++) {
+            if (hasJob[slot]) {
+                job = std::move(pendingJobs[slot]);
+                hasJob[slot] = false;
+                jobCount--;
+                break;
+            }
+        }
+        lock.unlock();
+
+        CompileResult result;
+        result.slot = job.slot;
+        result.generation = job.generation;
+        result.cacheKey = job.cacheKey;
+        result.program = CompileProgram(job.vertexSource, job.fragmentSource, &result.log);
+        glFinish(); // the program must be complete before the main context uses it
+
+        lock.lock();
+        results.push_back(std::move(result));
+    }
+    SDL_GL_MakeCurrent(workerWindow, NULL);
+}
+
+static void AbandonParallelBuild(int slot){
+    ProgramBuild& build = parallelBuilds[slot].build;
+    if (build.program == 0) {
+        return;
+    }
+    glDeleteShader(build.vertexShader);
+    glDeleteShader(build.fragmentShader);
+    glDeleteProgram(build.program);
+    build = ProgramBuild();
+}
+
+bool InitShaderCompiler(SDL_Window* window, SDL_GLContext mainContext){
+    if (GLAD_GL_KHR_parallel_shader_compile) {
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFF); // let the driver pick
+        mode = Compile_Parallel;
+        return true;
+    }
+
+    workerWindow = SDL_CreateWindow("shader compiler", 1, 1, SDL_WINDOW_OPENGL|SDL_WINDOW_HIDDEN);
+    if (workerWindow == NULL) {
+        SDL_Log("Couldn't create shader compile window, compiling synchronously: %s", SDL_GetError());
+        mode = Compile_Sync;
+        return false;
+    }
+    SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 1);
+    workerContext = SDL_GL_CreateContext(workerWindow);
+    SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 0);
+    SDL_GL_MakeCurrent(window, mainContext); // creating made the new context current
+    if (workerContext == NULL) {
+        SDL_Log("Couldn't create shader compile context, compiling synchronously: %s", SDL_GetError());
+        SDL_DestroyWindow(workerWindow);
+        workerWindow = NULL;
+        mode = Compile_Sync;
+        return false;
+    }
+    workerQuit = false;
+    workerStarted = 0;
+    worker = std::thread(WorkerMain);
+    bool started;
+    {
+        std::unique_lock<std::mutex> lock(compileMutex);
+        compileWake.wait(lock, []{ return workerStarted != 0; });
+        started = workerStarted > 0;
+    }
+    if (!started) {
+        worker.join();
+        SDL_GL_DestroyContext(workerContext);
+        SDL_DestroyWindow(workerWindow);
+        workerContext = NULL;
+        workerWindow = NULL;
+        SDL_Log("Compiling shaders synchronously");
+        mode = Compile_Sync;
+        return false;
+    }
+    mode = Compile_Worker;
+    return true;
+}
+
+void ShutdownShaderCompiler(){
+    if (mode == Compile_Worker) {
+        {
+            std::lock_guard<std::mutex> lock(compileMutex);
+            workerQuit = true;
+        }
+        compileWake.notify_one();
+        worker.join();
+        SDL_GL_DestroyContext(workerContext);
+        SDL_DestroyWindow(workerWindow);
+        workerContext = NULL;
+        workerWindow = NULL;
+    }
+    for (int slot = 0; slot < SHADER_SLOT_COUNT; slot++) {
+        AbandonParallelBuild(slot);
+    }
+    for (CompileResult& result : results) {
+        glDeleteProgram(result.program);
+    }
+    results.clear();
+    mode = Compile_Sync;
+}
+
+void SubmitShaderCompile(int slot, const std::string& vertexSource, const std::string& fragmentSource,
+                         const SourceMap* sourceMap){
+    unsigned generation = ++submitted[slot];
+    sourceMaps[slot] = sourceMap ? *sourceMap : SourceMap();
+    Uint64 cacheKey = ProgramCacheKey(vertexSource, fragmentSource);
+
+    // a cached binary links in about the time a glProgramBinary takes, no need to go async
+    GLuint cached = LoadCachedProgram(cacheKey);
+    if (cached != 0) {
+        AbandonParallelBuild(slot);
+        CompileResult result;
+        result.slot = slot;
+        result.generation = generation;
+        result.cacheKey = cacheKey;
+        result.fromCache = true;
+        result.program = cached;
+        std::lock_guard<std::mutex> lock(compileMutex);
+        results.push_back(std::move(result));
+        return;
+    }
+
+    switch (mode) {
+        case Compile_Parallel: {
+            ParallelBuild& parallel = parallelBuilds[slot];
+            AbandonParallelBuild(slot);
+            parallel.build = StartProgramBuild(vertexSource, fragmentSource);
+            parallel.generation = generation;
+            parallel.cacheKey = cacheKey;
+            break;
+        }
+        case Compile_Worker: {
+            std::lock_guard<std::mutex> lock(compileMutex);
+            CompileJob& job = pendingJobs[slot];
+            job.slot = slot;
+            job.generation = generation;
+            job.cacheKey = cacheKey;
+            job.vertexSource = vertexSource;
+            job.fragmentSource = fragmentSource;
+            if (!hasJob[slot]) {
+                hasJob[slot] = true;
+                jobCount++;
+            }
+            compileWake.notify_one();
+            break;
+        }
+        case Compile_Sync: {
+            CompileResult result;
+            result.slot = slot;
+            result.generation = generation;
+            result.cacheKey = cacheKey;
+            result.program = CompileProgram(vertexSource, fragmentSource, &result.log);
+            std::lock_guard<std::mutex> lock(compileMutex);
+            results.push_back(std::move(result));
+            break;
+        }
+    }
+}
+
+// Returns true when `result` is the newest build of its slot and linked.
+static bool HandleResult(CompileResult& result, GLuint* program){
+    if (result.generation != submitted[result.slot]) {
+        glDeleteProgram(result.program); // superseded while building
+        return false;
+    }
+    completed[result.slot] = result.generation;
+    if (!result.log.empty()) {
+        logs.push_back(MapShaderLog(result.log, sourceMaps[result.slot]));
+    }
+    if (result.program == 0) {
+        return false;
+    }
+    if (!result.fromCache) {
+        StoreCachedProgram(result.cacheKey, result.program);
+    }
+    *program = result.program;
+    return true;
+}
+
+bool PollShaderCompile(int slot, GLuint* program){
+    bool linked = false;
+    ParallelBuild& parallel = parallelBuilds[slot];
+    if (mode == Compile_Parallel && parallel.build.program != 0) {
+        GLint done = GL_FALSE;
+        glGetProgramiv(parallel.build.program, GL_COMPLETION_STATUS_KHR, &done);
+        if (done) {
+            CompileResult result;
+            result.slot = slot;
+            result.generation = parallel.generation;
+            result.cacheKey = parallel.cacheKey;
+            result.program = FinishProgramBuild(&parallel.build, &result.log);
+            linked = HandleResult(result, program);
+        }
+    }
+
+    // worker and synchronous builds, and cache hits in every mode
+    std::deque<CompileResult> ready;
+    {
+        std::lock_guard<std::mutex> lock(compileMutex);
+        for (auto it = results.begin(); it != results.end();) {
+            if (it->slot == slot) {
+                ready.push_back(std::move(*it));
+                it = results.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    for (CompileResult& result : ready) {
+        linked = HandleResult(result, program) || linked;
+    }
+    return linked;
+}
+
+bool IsShaderCompilePending(){
+    for (int slot = 0; slot < SHADER_SLOT_COUNT; slot++) {
+        if (completed[slot] != submitted[slot]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::vector<std::string> TakeShaderLogs(){
+    std::vector<std::string> taken;
+    taken.swap(logs);
+    return taken;
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <glad/gl.h>
+#include <SDL3/SDL.h>
+#include <string>
+#include <vector>
+
+struct SourceMap;
+
+// Builds shader programs without stalling the frame loop.
+// Uses GL_KHR_parallel_shader_compile when the driver has it, otherwise a
+// worker thread with a context shared with `mainContext`, current on a hidden
+// window of its own. If neither is possible builds run synchronously on submit.
+// Everything but the worker itself runs on the main thread.
+bool InitShaderCompiler(SDL_Window* window, SDL_GLContext mainContext);
+void ShutdownShaderCompiler();
+
+// Each slot holds one program being rebuilt independently (one per
+// multipass pass, see multipass.h); single-shader use only needs slot 0.
+static const int SHADER_SLOT_COUNT = 5;
+
+// Starts building a program for `slot`. A build of the same slot still in
+// flight is superseded and its result dropped. With `sourceMap` the fragment
+// errors in the log point at the original files and lines.
+void SubmitShaderCompile(int slot, const std::string& vertexSource, const std::string& fragmentSource,
+                         const SourceMap* sourceMap = NULL);
+
+// Call once per frame and slot. Returns true and hands over a linked program
+// once the latest build for the slot succeeded; keep drawing the old program
+// until then.
+bool PollShaderCompile(int slot, GLuint* program);
+bool IsShaderCompilePending(); // any slot
+
+// Compile and link logs produced since the last call, oldest first.
+std::vector<std::string> TakeShaderLogs();
@@ -0,0 +1,327 @@
+#include "shader_preprocessor.h"
+#include <SDL3/SDL.h>
+#include <map>
+#include <set>
+
+struct CachedFile {
+    bool loaded = false;
+    std::vector<std::string> lines;
+    bool expanded = false;
+    bool expanding = false;             // on the include stack, catches cycles
+    std::string text;
+    SourceMap map;
+    std::vector<std::string> includes;  // direct includes, normalized
+};
+
+// std::map keeps references stable while nested includes insert entries
+static std::map<std::string, CachedFile> cache;
+static std::map<std::string, std::set<std::string>> includedBy;
+
+static bool IsSeparator(char c){
+    return c == '/' || c == '\\';
+}
+
+static bool IsAbsolutePath(const std::string& path){
+    return (!path.empty() && IsSeparator(path[0])) || (path.size() > 1 && path[1] == ':');
+}
+
+std::string NormalizeShaderPath(const std::string& path){
+    if (path.empty()) {
+        return path;
+    }
+    std::vector<std::string> parts;
+    size_t start = 0;
+    while (start <= path.size()) {
+        size_t end = start;
+        while (end < path.size() && !IsSeparator(path[end])) {
+            end++;
+        }
+        std::string part = path.substr(start, end - start);
+        if (part == "..") {
+            if (!parts.empty() && parts.back() != ".." && !parts.back().empty()) {
+                parts.pop_back();
+            } else {
+                parts.push_back(part);
+            }
+        } else if (part != "." && !(part.empty() && !parts.empty())) {
+            parts.push_back(part); // a leading empty part keeps the root of absolute paths
+        }
+        start = end + 1;
+    }
+    std::string normalized;
+    for (size_t i = 0; i < parts.size(); i++) {
+        normalized += (i > 0 ? "/" : "") + parts[i];
+    }
+    return parts.size() == 1 && parts[0].empty() ? "/" : normalized;
+}
+
+static std::string DirectoryOf(const std::string& path){
+    size_t slash = path.find_last_of("/\\");
+    return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+}
+
+static bool LoadLines(const std::string& path, std::vector<std::string>* lines){
+    size_t fileSize = 0;
+    void* fileData = SDL_LoadFile(path.c_str(), &fileSize);
+    if (fileData == NULL) {
+        return false;
+    }
+    const char* text = (const char*)fileData;
+    lines->clear();
+    size_t start = 0;
+    for (size_t i = 0; i <= fileSize; i++) {
+        if (i == fileSize || text[i] == '\n') {
+            size_t end = (i > start && text[i - 1] == '\r') ? i - 1 : i;
+            if (i < fileSize || end > start) {
+                lines->push_back(std::string(text + start, end - start));
+            }
+            start = i + 1;
+        }
+    }
+    SDL_free(fileData);
+    return true;
+}
+
+// `#include "file"` or `#include <file>`, whitespace allowed around the '#'.
+static bool ParseInclude(const std::string& line, std::string* target){
+    size_t i = line.find_first_not_of(" \t");
+    if (i == std::string::npos || line[i] != '#') {
+        return false;
+    }
+    i = line.find_first_not_of(" \t", i + 1);
+    if (i == std::string::npos || line.compare(i, 7, "include") != 0) {
+        return false;
+    }
+    i = line.find_first_not_of(" \t", i + 7);
+    if (i == std::string::npos || (line[i] != '"' && line[i] != '<')) {
+        return false;
+    }
+    char close = line[i] == '"' ? '"' : '>';
+    size_t end = line.find(close, i + 1);
+    if (end == std::string::npos || end == i + 1) {
+        return false;
+    }
+    *target = line.substr(i + 1, end - i - 1);
+    return true;
+}
+
+// Tracks /* */ across lines so commented-out includes stay comments.
+static void UpdateCommentState(const std::string& line, bool* inComment){
+    for (size_t i = 0; i + 1 < line.size(); i++) {
+        if (*inComment) {
+            if (line[i] == '*' && line[i + 1] == '/') {
+                *inComment = false;
+                i++;
+            }
+        } else if (line[i] == '/' && line[i + 1] == '/') {
+            return;
+        } else if (line[i] == '/' && line[i + 1] == '*') {
+            *inComment = true;
+            i++;
+        }
+    }
+}
+
+static int MapFileIndex(SourceMap* map, const std::string& file){
+    for (size_t i = 0; i < map->files.size(); i++) {
+        if (map->files[i] == file) {
+            return (int)i;
+        }
+    }
+    map->files.push_back(file);
+    return (int)map->files.size() - 1;
+}
+
+static CachedFile* Expand(const std::string& path, std::string* error){
+    CachedFile& file = cache[path];
+    if (file.expanded) {
+        return &file;
+    }
+    if (file.expanding) {
+        *error = "#include cycle through " + path;
+        return NULL;
+    }
+    if (!file.loaded) {
+        if (!LoadLines(path, &file.lines)) {
+            *error = "can't open " + path + ": " + SDL_GetError();
+            return NULL;
+        }
+        file.loaded = true;
+    }
+
+    for (const std::string& include : file.includes) {
+        includedBy[include].erase(path);
+    }
+    file.includes.clear();
+    file.text.clear();
+    file.map = SourceMap();
+    file.map.files.push_back(path);
+    file.expanding = true;
+
+    std::string directory = DirectoryOf(path);
+    bool inComment = false;
+    bool ok = true;
+    for (size_t i = 0; i < file.lines.size() && ok; i++) {
+        const std::string& line = file.lines[i];
+        std::string target;
+        if (!inComment && ParseInclude(line, &target)) {
+            std::string includePath = NormalizeShaderPath(IsAbsolutePath(target) ? target : directory + target);
+            file.includes.push_back(includePath);
+            includedBy[includePath].insert(path);
+            std::string childError;
+            CachedFile* child = Expand(includePath, &childError);
+            if (child == NULL) {
+                *error = path + ":" + std::to_string(i + 1) + ": " + childError;
+                ok = false;
+                break;
+            }
+            file.text += child->text;
+            for (const SourceMap::Line& childLine : child->map.lines) {
+                SourceMap::Line mapped;
+                mapped.file = MapFileIndex(&file.map, child->map.files[childLine.file]);
+                mapped.line = childLine.line;
+                file.map.lines.push_back(mapped);
+            }
+            continue;
+        }
+        UpdateCommentState(line, &inComment);
+        file.text += line;
+        file.text += '\n';
+        SourceMap::Line mapped;
+        mapped.line = (int)i + 1;
+        file.map.lines.push_back(mapped);
+    }
+    file.expanding = false;
+    if (!ok) {
+        file.text.clear();
+        file.map = SourceMap();
+        return NULL;
+    }
+    file.expanded = true;
+    return &file;
+}
+
+bool ExpandShader(const std::string& path, std::string* text, SourceMap* map, std::string* error){
+    CachedFile* file = Expand(NormalizeShaderPath(path), error);
+    if (file == NULL) {
+        return false;
+    }
+    *text = file->text;
+    *map = file->map;
+    return true;
+}
+
+std::vector<std::string> InvalidateShaderFile(const std::string& path){
+    std::string normalized = NormalizeShaderPath(path);
+    std::vector<std::string> changed;
+    std::set<std::string> seen;
+    std::vector<std::string> stack(1, normalized);
+    while (!stack.empty()) {
+        std::string current = stack.back();
+        stack.pop_back();
+        if (!seen.insert(current).second) {
+            continue;
+        }
+        changed.push_back(current);
+        auto it = cache.find(current);
+        if (it != cache.end()) {
+            it->second.expanded = false;
+            it->second.text.clear();
+            it->second.map = SourceMap();
+            if (current == normalized) {
+                it->second.loaded = false;
+            }
+        }
+        for (const std::string& parent : includedBy[current]) {
+            stack.push_back(parent);
+        }
+    }
+    return changed;
+}
+
+void ClearShaderCache(){
+    cache.clear();
+    includedBy.clear();
+}
+
+std::vector<std::string> ShaderDependencies(const std::string& path){
+    std::vector<std::string> files;
+    std::set<std::string> seen;
+    std::vector<std::string> stack(1, NormalizeShaderPath(path));
+    while (!stack.empty()) {
+        std::string current = stack.back();
+        stack.pop_back();
+        if (!seen.insert(current).second) {
+            continue;
+        }
+        files.push_back(current);
+        auto it = cache.find(current);
+        if (it != cache.end()) {
+            stack.insert(stack.end(), it->second.includes.begin(), it->second.includes.end());
+        }
+    }
+    return files;
+}
+
+// Finds "0:<n>" or "0(<n>)" starting a token, returns the line number and
+// the span to replace.
+static bool FindLineReference(const std::string& line, size_t from, size_t* start, size_t* length, int* number){
+    for (size_t i = from; i + 2 < line.size(); i++) {
+        if (line[i] != '0' || (i > 0 && line[i - 1] != ' ') || (line[i + 1] != ':' && line[i + 1] != '(')) {
+            continue;
+        }
+        size_t j = i + 2;
+        int n = 0;
+        while (j < line.size() && line[j] >= '0' && line[j] <= '9') {
+            n = n * 10 + (line[j] - '0');
+            j++;
+        }
+        if (j == i + 2) {
+            continue;
+        }
+        if (line[i + 1] == '(') {
+            if (j >= line.size() || line[j] != ')') {
+                continue;
+            }
+            j++;
+        }
+        *start = i;
+        *length = j - i;
+        *number = n;
+        return true;
+    }
+    return false;
+}
+
+std::string MapShaderLog(const std::string& log, const SourceMap& map){
+    static const char kHeader[] = "Shader Compilation Error (";
+    std::string mapped;
+    bool fragment = false;
+    size_t start = 0;
+    while (start < log.size()) {
+        size_t end = log.find('\n', start);
+        if (end == std::string::npos) {
+            end = log.size();
+        }
+        std::string line = log.substr(start, end - start);
+        size_t from = 0;
+        if (line.compare(0, sizeof(kHeader) - 1, kHeader) == 0) {
+            fragment = line.find("(FRAGMENT)") != std::string::npos;
+            size_t colon = line.find("): ");
+            from = colon == std::string::npos ? line.size() : colon + 3;
+        }
+        size_t at = 0, length = 0;
+        int number = 0;
+        if (fragment && FindLineReference(line, from, &at, &length, &number) &&
+            number >= 1 && number <= (int)map.lines.size()) {
+            const SourceMap::Line& origin = map.lines[number - 1];
+            line.replace(at, length, map.files[origin.file] + ":" + std::to_string(origin.line));
+        }
+        mapped += line;
+        if (end < log.size()) {
+            mapped += '\n';
+        }
+        start = end + 1;
+    }
+    return mapped;
+}
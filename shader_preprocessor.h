@@ -0,0 +1,38 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// #include for fragment shaders ////
+// `#include "file"` (or <file>) pastes a file resolved relative to the one
+// including it. Inclusion is textual like in C, so shared libraries guard
+// themselves with #ifndef/#define. The expanded text of every file is cached
+// until it, or anything it includes, is invalidated.
+
+// Where each line of an expanded shader came from.
+struct SourceMap {
+    struct Line {
+        int file = 0;   // index into files
+        int line = 0;   // 1-based
+    };
+    std::vector<std::string> files;
+    std::vector<Line> lines;    // index = expanded line - 1
+};
+
+// Expands `path` into `text`. On failure `error` names the file and line
+// that broke (missing include, include cycle).
+bool ExpandShader(const std::string& path, std::string* text, SourceMap* map, std::string* error);
+
+// Forgets the text of `path` and the cached expansion of everything that
+// includes it. Returns the files whose expansion changed, `path` included.
+std::vector<std::string> InvalidateShaderFile(const std::string& path);
+void ClearShaderCache();
+
+// `path` and every file it includes, as of the last expansion.
+std::vector<std::string> ShaderDependencies(const std::string& path);
+
+// Rewrites driver line references ("0:12(3):", "0(12) :", "ERROR: 0:12:") in
+// the fragment part of a compile log to "file:line".
+std::string MapShaderLog(const std::string& log, const SourceMap& map);
+
+// Lexically normalized path ("a/./b/../c" -> "a/c"), used as the cache key.
+std::string NormalizeShaderPath(const std::string& path);
@@ -0,0 +1,469 @@
+#include "texture_loader.h"
+#include "thread_pool.h"
+#include <SDL3/SDL.h>
+#include <string.h>
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <unordered_map>
+
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_ONLY_PNG
+#define STBI_ONLY_JPEG
+#include "stb_image.h"
+
+// Decoding (worker threads) ////
+struct MipLevel {
+    size_t offset = 0;
+    size_t size = 0;
+    int width = 0;
+    int height = 0;
+};
+
+struct DecodedImage {
+    int id = 0;
+    bool ok = false;
+    bool compressed = false;
+    GLenum internalFormat = 0;
+    GLenum format = 0;      // uncompressed only
+    GLenum type = 0;
+    int pixelSize = 0;      // bytes per texel, uncompressed only
+    int blockSize = 0;      // bytes per 4x4 block, compressed only
+    std::vector<MipLevel> levels;
+    std::vector<unsigned char> data;
+};
+
+struct DdsPixelFormat {
+    Uint32 size, flags, fourCC, rgbBitCount, rMask, gMask, bMask, aMask;
+};
+
+struct DdsHeader {
+    Uint32 size, flags, height, width, pitchOrLinearSize, depth, mipMapCount;
+    Uint32 reserved1[11];
+    DdsPixelFormat pixelFormat;
+    Uint32 caps, caps2, caps3, caps4, reserved2;
+};
+static_assert(sizeof(DdsHeader) == 124, "DdsHeader must match the file layout");
+
+static const Uint32 kDdsFlagMipMapCount = 0x20000;
+
+static Uint32 FourCC(const char* code){
+    return (Uint32)code[0] | ((Uint32)code[1] << 8) | ((Uint32)code[2] << 16) | ((Uint32)code[3] << 24);
+}
+
+static bool IsDds(const unsigned char* bytes, size_t size){
+    return size >= 4 && memcmp(bytes, "DDS ", 4) == 0;
+}
+
+// Keeps the DXT blocks as they are, with the file's own mip chain.
+// DDS rows are stored top-down and are not flipped.
+static bool DecodeDds(const unsigned char* bytes, size_t size, const std::string& path, DecodedImage* image){
+    DdsHeader header;
+    if (size < 4 + sizeof(header)) {
+        SDL_Log("%s: truncated DDS header", path.c_str());
+        return false;
+    }
+    memcpy(&header, bytes + 4, sizeof(header));
+    Uint32 fourCC = header.pixelFormat.fourCC;
+    if (fourCC == FourCC("DXT1")) {
+        image->internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+        image->blockSize = 8;
+    } else if (fourCC == FourCC("DXT3")) {
+        image->internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT3_EXT;
+        image->blockSize = 16;
+    } else if (fourCC == FourCC("DXT5")) {
+        image->internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        image->blockSize = 16;
+    } else {
+        SDL_Log("%s: only DXT1, DXT3 and DXT5 DDS files are supported", path.c_str());
+        return false;
+    }
+    if (!GLAD_GL_EXT_texture_compression_s3tc) {
+        SDL_Log("%s: the driver has no GL_EXT_texture_compression_s3tc", path.c_str());
+        return false;
+    }
+    if (header.width == 0 || header.height == 0) {
+        SDL_Log("%s: empty DDS image", path.c_str());
+        return false;
+    }
+
+    const unsigned char* payload = bytes + 4 + sizeof(header);
+    size_t payloadSize = size - 4 - sizeof(header);
+    int levelCount = (header.flags & kDdsFlagMipMapCount) && header.mipMapCount > 0 ? (int)header.mipMapCount : 1;
+    int width = (int)header.width;
+    int height = (int)header.height;
+    size_t offset = 0;
+    for (int l = 0; l < levelCount; l++) {
+        MipLevel level;
+        level.offset = offset;
+        level.width = width;
+        level.height = height;
+        level.size = (size_t)((width + 3) / 4) * ((height + 3) / 4) * image->blockSize;
+        if (offset + level.size > payloadSize) {
+            break; // truncated chain, keep the complete levels
+        }
+        image->levels.push_back(level);
+        offset += level.size;
+        if (width == 1 && height == 1) {
+            break;
+        }
+        width = std::max(1, width / 2);
+        height = std::max(1, height / 2);
+    }
+    if (image->levels.empty()) {
+        SDL_Log("%s: truncated DDS data", path.c_str());
+        return false;
+    }
+    image->compressed = true;
+    image->data.assign(payload, payload + offset);
+    return true;
+}
+
+// PNG and JPEG as RGBA, 16 bit PNGs (LUTs) keep their precision. Rows are
+// flipped to GL's bottom-up order so images appear upright, like Shadertoy.
+static bool DecodeStb(const unsigned char* bytes, size_t size, const std::string& path, DecodedImage* image){
+    int width = 0, height = 0, channels = 0;
+    bool wide = stbi_is_16_bit_from_memory(bytes, (int)size) != 0;
+    void* pixels = wide ? (void*)stbi_load_16_from_memory(bytes, (int)size, &width, &height, &channels, 4)
+                        : (void*)stbi_load_from_memory(bytes, (int)size, &width, &height, &channels, 4);
+    if (pixels == NULL) {
+        SDL_Log("Error decoding '%s': %s", path.c_str(), stbi_failure_reason());
+        return false;
+    }
+    image->internalFormat = wide ? GL_RGBA16 : GL_RGBA8;
+    image->format = GL_RGBA;
+    image->type = wide ? GL_UNSIGNED_SHORT : GL_UNSIGNED_BYTE;
+    image->pixelSize = wide ? 8 : 4;
+
+    size_t rowBytes = (size_t)width * image->pixelSize;
+    image->data.resize(rowBytes * height);
+    for (int y = 0; y < height; y++) {
+        memcpy(&image->data[(size_t)(height - 1 - y) * rowBytes], (unsigned char*)pixels + (size_t)y * rowBytes, rowBytes);
+    }
+    stbi_image_free(pixels);
+
+    MipLevel level;
+    level.size = image->data.size();
+    level.width = width;
+    level.height = height;
+    image->levels.push_back(level);
+    return true;
+}
+
+static ThreadPool pool;
+static std::mutex decodedMutex;
+static std::deque<std::unique_ptr<DecodedImage>> decoded;
+
+static void DecodeJob(int id, const std::string& path){
+    std::unique_ptr<DecodedImage> image(new DecodedImage());
+    image->id = id;
+    size_t size = 0;
+    void* bytes = SDL_LoadFile(path.c_str(), &size);
+    if (bytes == NULL) {
+        SDL_Log("Error loading texture '%s': %s", path.c_str(), SDL_GetError());
+    } else {
+        const unsigned char* data = (const unsigned char*)bytes;
+        image->ok = IsDds(data, size) ? DecodeDds(data, size, path, image.get())
+                                      : DecodeStb(data, size, path, image.get());
+        SDL_free(bytes);
+    }
+    std::lock_guard<std::mutex> lock(decodedMutex);
+    decoded.push_back(std::move(image));
+}
+
+// Uploading (main thread) ////
+struct TextureEntry {
+    std::string path;
+    int refs = 0;
+    bool ready = false;
+    bool failed = false;
+    TextureInfo info;
+};
+
+struct Upload {
+    std::unique_ptr<DecodedImage> image;
+    GLuint texture = 0;
+    size_t level = 0;   // next level to stream
+    int row = 0;        // next texel row of that level
+};
+
+// Staging ring: a buffer is refilled only once the GPU signalled its fence,
+// so mapping never waits. GL 3.3 has no persistent mapping, each chunk maps
+// the whole range unsynchronized instead.
+struct StagingBuffer {
+    GLuint pbo = 0;
+    GLsync fence = NULL;
+};
+
+static const int STAGING_COUNT = 3;
+static const size_t STAGING_BYTES = 4u * 1024 * 1024;
+static const int MAX_DECODE_THREADS = 4;
+
+static std::unordered_map<int, TextureEntry> entries;
+static std::deque<Upload> uploads;
+static StagingBuffer staging[STAGING_COUNT];
+static int stagingIndex = 0;
+static int nextId = 1;
+static int decodingCount = 0;
+
+bool InitTextureLoader(){
+    StartThreadPool(&pool, std::min(MAX_DECODE_THREADS, DefaultWorkerCount()));
+    for (int i = 0; i < STAGING_COUNT; i++) {
+        glGenBuffers(1, &staging[i].pbo);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, staging[i].pbo);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, STAGING_BYTES, NULL, GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    return true;
+}
+
+static void DeleteTexture(TextureInfo* info){
+    if (info->handle != 0) {
+        glMakeTextureHandleNonResidentARB(info->handle);
+    }
+    glDeleteTextures(1, &info->texture);
+    *info = TextureInfo();
+}
+
+void ShutdownTextureLoader(){
+    StopThreadPool(&pool);
+    decoded.clear();
+    for (Upload& upload : uploads) {
+        glDeleteTextures(1, &upload.texture);
+    }
+    uploads.clear();
+    for (auto& it : entries) {
+        DeleteTexture(&it.second.info);
+    }
+    entries.clear();
+    for (int i = 0; i < STAGING_COUNT; i++) {
+        if (staging[i].fence != NULL) {
+            glDeleteSync(staging[i].fence);
+        }
+        glDeleteBuffers(1, &staging[i].pbo);
+        staging[i] = StagingBuffer();
+    }
+    decodingCount = 0;
+}
+
+int RequestTexture(const std::string& path){
+    for (auto& it : entries) {
+        if (it.second.path == path && !it.second.failed) {
+            it.second.refs++;
+            return it.first;
+        }
+    }
+    int id = nextId++;
+    TextureEntry& entry = entries[id];
+    entry.path = path;
+    entry.refs = 1;
+    decodingCount++;
+    SubmitJob(&pool, [id, path]() { DecodeJob(id, path); });
+    return id;
+}
+
+void ReleaseTexture(int id){
+    auto it = entries.find(id);
+    if (it == entries.end() || --it->second.refs > 0) {
+        return;
+    }
+    DeleteTexture(&it->second.info);
+    entries.erase(it); // a decode or upload still in flight is dropped when it shows up
+}
+
+bool IsTextureLoadPending(){
+    return decodingCount > 0 || !uploads.empty();
+}
+
+bool GetTexture(int id, TextureInfo* info){
+    auto it = entries.find(id);
+    if (it == entries.end() || !it->second.ready) {
+        return false;
+    }
+    *info = it->second.info;
+    return true;
+}
+
+bool IsTextureFailed(int id){
+    auto it = entries.find(id);
+    return it != entries.end() && it->second.failed;
+}
+
+// Allocates every level up front; texels arrive chunk by chunk.
+static GLuint CreateTexture(const DecodedImage& image, const std::string& path){
+    GLint maxSize = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+    if (image.levels[0].width > maxSize || image.levels[0].height > maxSize) {
+        SDL_Log("%s: %dx%d is larger than GL_MAX_TEXTURE_SIZE (%d)", path.c_str(), image.levels[0].width, image.levels[0].height, maxSize);
+        return 0;
+    }
+    GLuint texture = 0;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    if (image.compressed) {
+        for (size_t l = 0; l < image.levels.size(); l++) {
+            const MipLevel& level = image.levels[l];
+            glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)l, image.internalFormat, level.width, level.height, 0, (GLsizei)level.size, NULL);
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)image.levels.size() - 1);
+    } else {
+        const MipLevel& level = image.levels[0];
+        glTexImage2D(GL_TEXTURE_2D, 0, image.internalFormat, level.width, level.height, 0, image.format, image.type, NULL);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return texture;
+}
+
+// Streams the next rows of `upload` through one staging buffer. Returns false
+// when that buffer is still being read by the GPU.
+static bool UploadChunk(Upload* upload, size_t budget, size_t* sent){
+    StagingBuffer& slot = staging[stagingIndex];
+    if (slot.fence != NULL) {
+        if (glClientWaitSync(slot.fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+            return false;
+        }
+        glDeleteSync(slot.fence);
+        slot.fence = NULL;
+    }
+
+    const DecodedImage& image = *upload->image;
+    const MipLevel& level = image.levels[upload->level];
+    // compressed data moves in rows of 4x4 blocks
+    int rowHeight = image.compressed ? 4 : 1;
+    size_t rowBytes = image.compressed ? (size_t)((level.width + 3) / 4) * image.blockSize
+                                       : (size_t)level.width * image.pixelSize;
+    int rowsLeft = (level.height - upload->row + rowHeight - 1) / rowHeight;
+    int rows = (int)std::max<size_t>(1, std::min(STAGING_BYTES, budget) / rowBytes);
+    rows = std::min(rows, rowsLeft);
+    int y = upload->row;
+    int height = std::min(rows * rowHeight, level.height - y);
+    size_t bytes = (size_t)rows * rowBytes;
+    const unsigned char* source = &image.data[level.offset + (size_t)(y / rowHeight) * rowBytes];
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.pbo);
+    void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes,
+                                    GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    bool copied = false;
+    if (mapped != NULL) {
+        memcpy(mapped, source, bytes);
+        copied = glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_TRUE;
+    }
+    if (!copied) {
+        glBufferSubData(GL_PIXEL_UNPACK_BUFFER, 0, bytes, source);
+    }
+
+    glBindTexture(GL_TEXTURE_2D, upload->texture);
+    if (image.compressed) {
+        glCompressedTexSubImage2D(GL_TEXTURE_2D, (GLint)upload->level, 0, y, level.width, height,
+                                  image.internalFormat, (GLsizei)bytes, (const void*)0);
+    } else {
+        glTexSubImage2D(GL_TEXTURE_2D, (GLint)upload->level, 0, y, level.width, height,
+                        image.format, image.type, (const void*)0);
+    }
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    stagingIndex = (stagingIndex + 1) % STAGING_COUNT;
+
+    upload->row += height;
+    if (upload->row >= level.height) {
+        upload->level++;
+        upload->row = 0;
+    }
+    *sent = bytes;
+    return true;
+}
+
+static void FinishTexture(const Upload& upload, TextureEntry* entry){
+    const DecodedImage& image = *upload.image;
+    bool mipmapped = true;
+    glBindTexture(GL_TEXTURE_2D, upload.texture);
+    if (!image.compressed) {
+        glGenerateMipmap(GL_TEXTURE_2D);
+    } else if (image.levels.size() == 1) {
+        // DDS without a mip chain: most drivers generate S3TC mips, core GL
+        // doesn't have to, so without them it samples the base level only
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 1000);
+        while (glGetError() != GL_NO_ERROR) {
+        }
+        glGenerateMipmap(GL_TEXTURE_2D);
+        mipmapped = glGetError() == GL_NO_ERROR;
+        if (!mipmapped) {
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+            SDL_Log("%s: no mip chain and the driver can't generate one, minified sampling will alias", entry->path.c_str());
+        }
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, mipmapped ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    entry->info.texture = upload.texture;
+    entry->info.width = image.levels[0].width;
+    entry->info.height = image.levels[0].height;
+    if (GLAD_GL_ARB_bindless_texture) {
+        // the handle freezes the texture's state, so it's taken last
+        entry->info.handle = glGetTextureHandleARB(upload.texture);
+        glMakeTextureHandleResidentARB(entry->info.handle);
+    }
+    entry->ready = true;
+}
+
+void UpdateTextureLoader(size_t budgetBytes){
+    std::deque<std::unique_ptr<DecodedImage>> finished;
+    {
+        std::lock_guard<std::mutex> lock(decodedMutex);
+        finished.swap(decoded);
+    }
+    for (std::unique_ptr<DecodedImage>& image : finished) {
+        decodingCount--;
+        auto entry = entries.find(image->id);
+        if (entry == entries.end()) {
+            continue; // released while decoding
+        }
+        GLuint texture = image->ok ? CreateTexture(*image, entry->second.path) : 0;
+        if (texture == 0) {
+            entry->second.failed = true;
+            continue;
+        }
+        Upload upload;
+        upload.image = std::move(image);
+        upload.texture = texture;
+        uploads.push_back(std::move(upload));
+    }
+    if (uploads.empty()) {
+        return;
+    }
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4); // RGBA rows and DXT blocks are always 4 byte aligned
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    size_t spent = 0;
+    while (!uploads.empty() && spent < budgetBytes) {
+        Upload& upload = uploads.front();
+        auto entry = entries.find(upload.image->id);
+        if (entry == entries.end()) {
+            glDeleteTextures(1, &upload.texture);
+            uploads.pop_front();
+            continue;
+        }
+        size_t sent = 0;
+        if (!UploadChunk(&upload, budgetBytes - spent, &sent)) {
+            break;
+        }
+        spent += sent;
+        if (upload.level == upload.image->levels.size()) {
+            FinishTexture(upload, &entry->second);
+            uploads.pop_front();
+        }
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+bool IsTextureFile(const std::string& path){
+    size_t dot = path.find_last_of('.');
+    if (dot == std::string::npos) {
+        return false;
+    }
+    std::string ext = path.substr(dot + 1);
+    return SDL_strcasecmp(ext.c_str(), "png") == 0 || SDL_strcasecmp(ext.c_str(), "jpg") == 0 ||
+           SDL_strcasecmp(ext.c_str(), "jpeg") == 0 || SDL_strcasecmp(ext.c_str(), "dds") == 0;
+}
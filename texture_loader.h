@@ -0,0 +1,38 @@
+#pragma once
+#include <glad/gl.h>
+#include <string>
+
+// Textures for the iChannel inputs.
+// Files are read and decoded on a thread pool: PNG and JPEG through stb_image,
+// DDS with DXT1/3/5 data kept compressed. The main thread then streams the
+// texels into GL through a small ring of pixel unpack buffers, at most a budget
+// per frame, so a 4K texture never stalls the frame loop.
+// Everything but decoding runs on the main thread.
+bool InitTextureLoader();
+void ShutdownTextureLoader();
+
+// Returns an id right away; the texture reads as not ready until uploaded.
+// Requesting a path that is already loaded shares the texture.
+int RequestTexture(const std::string& path);
+void ReleaseTexture(int id);
+
+// Moves uploads forward by at most `budgetBytes` of texel data without
+// waiting on the GPU. Call once per frame.
+void UpdateTextureLoader(size_t budgetBytes = 8u * 1024 * 1024);
+bool IsTextureLoadPending();
+
+struct TextureInfo {
+    GLuint texture = 0;
+    GLuint64 handle = 0;    // resident bindless handle, 0 without GL_ARB_bindless_texture
+    int width = 0;
+    int height = 0;
+};
+
+// False while the texture is still loading or failed to load.
+bool GetTexture(int id, TextureInfo* info);
+// True once decoding or creating the texture failed (bad file, too large);
+// such a texture never becomes ready.
+bool IsTextureFailed(int id);
+
+// Extensions the loader can decode, for file dialogs and drag and drop.
+bool IsTextureFile(const std::string& path);
@@ -0,0 +1,66 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads pulling jobs off one queue.
+// Jobs run without a GL context, hand results back to the main thread.
+struct ThreadPool {
+    std::vector<std::thread> threads;
+    std::deque<std::function<void()>> jobs;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+};
+
+// Hardware threads minus the main thread, at least one.
+inline int DefaultWorkerCount(){
+    int count = (int)std::thread::hardware_concurrency() - 1;
+    return count < 1 ? 1 : count;
+}
+
+inline void StartThreadPool(ThreadPool* pool, int threadCount){
+    pool->stopping = false;
+    for (int i = 0; i < threadCount; i++) {
+        pool->threads.emplace_back([pool]() {
+            for (;;) {
+                std::function<void()> job;
+                {
+                    std::unique_lock<std::mutex> lock(pool->mutex);
+                    pool->wake.wait(lock, [pool]() { return pool->stopping || !pool->jobs.empty(); });
+                    if (pool->stopping) {
+                        return;
+                    }
+                    job = std::move(pool->jobs.front());
+                    pool->jobs.pop_front();
+                }
+                job();
+            }
+        });
+    }
+}
+
+inline void SubmitJob(ThreadPool* pool, std::function<void()> job){
+    {
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        pool->jobs.push_back(std::move(job));
+    }
+    pool->wake.notify_one();
+}
+
+// Drops the jobs that haven't started and joins the workers.
+inline void StopThreadPool(ThreadPool* pool){
+    {
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        pool->stopping = true;
+        pool->jobs.clear();
+    }
+    pool->wake.notify_all();
+    for (std::thread& thread : pool->threads) {
+        thread.join();
+    }
+    pool->threads.clear();
+}